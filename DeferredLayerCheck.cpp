@@ -0,0 +1,152 @@
+// Checks that deferred layers (SetLayerDeferred) end up identical to drawing straight away
+// Every frame the same random draws go to an immediate and a deferred layer and the layers are compared.
+// The draws cover every pixel mode, blend factors, scaled/flipped/partial sprites, clears, and sprites
+// that are changed (drawn to or written directly) or freed after being blitted but before the frame ends.
+// Usage: DeferredLayerCheck [seed] [frames]
+
+#define OLC_PGE_APPLICATION
+#define OLC_PLATFORM_HEADLESS
+// Layers aren't deferred with a single worker, pin a few so the check means something on any machine
+#define OLC_RASTER_WORKERS 4u
+#include "olcPixelGameEngine.h"
+#include "./PixelGame/Random.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+class DeferredLayerCheck : public olc::PixelGameEngine {
+
+public:
+
+	int failures = 0;
+
+	DeferredLayerCheck(uint64_t seed, int frames) : seed(seed), frames(frames) { }
+
+private:
+
+	uint64_t seed;
+	int frames;
+	int frame = 0;
+
+	// Sprite every frame starts from, and the copy each layer's draws may change
+	olc::Sprite sprite{ 23, 17 };
+	olc::Sprite scratch[2] = { olc::Sprite(23, 17), olc::Sprite(23, 17) };
+
+	static void fill(olc::Sprite& s, Random& rng) {
+		for (int i = 0; i < s.width * s.height; i++) {
+			uint32_t p = rng.next();
+			if (rng.below(2)) p |= 0xFF000000;
+			s.GetData()[i] = olc::Pixel(p);
+		}
+	}
+
+	// One frame of draws to a layer, the same rng state gives the same draws
+	void draw(uint8_t layer, Random& rng) {
+
+		olc::Sprite& changed = scratch[layer - 1];
+		memcpy(changed.GetData(), sprite.GetData(), sprite.width * sprite.height * sizeof(olc::Pixel));
+		SetDrawTarget(layer);
+
+		if (rng.chance(3)) Clear(rng.below(4) ? olc::BLANK : olc::Pixel(rng.next()));
+
+		int n = int(rng.below(40));
+		for (int k = 0; k < n; k++) {
+
+			// Every value is drawn in its own statement so the order doesn't depend on the compiler
+			uint32_t mode = rng.below(8);
+			float blend = rng.below(100) / 99.0f;
+			int32_t x = int32_t(rng.below(300)) - 30;
+			int32_t y = int32_t(rng.below(200)) - 30;
+			int32_t w = int32_t(rng.below(150));
+			int32_t h = int32_t(rng.below(100));
+			uint32_t scale = 1 + rng.below(4);
+			uint8_t flip = uint8_t(rng.below(4));
+			int32_t ox = int32_t(rng.below(30)) - 3;
+			int32_t oy = int32_t(rng.below(20)) - 3;
+			olc::Pixel p(rng.next());
+
+			if (mode < 3) SetPixelMode(olc::Pixel::NORMAL);
+			else if (mode < 5) SetPixelMode(olc::Pixel::ALPHA);
+			else if (mode < 7) SetPixelMode(olc::Pixel::MASK);
+			else SetPixelMode([](int x, int y, const olc::Pixel& a, const olc::Pixel& b) { return olc::Pixel(a.r ^ b.g, uint8_t(x), uint8_t(y)); });
+			SetPixelBlend(blend);
+
+			switch (rng.below(10)) {
+			case 0: Draw(x, y, p); break;
+			case 1: FillRect(x, y, w, h, p); break;
+			case 2: DrawLine(x, y, w, h, p); break;
+			case 3: DrawSprite(x, y, &sprite, scale, flip); break;
+			case 4: DrawString(x, y, "deferred", p, 1 + scale % 2); break;
+			case 5: FillCircle(x, y, h % 40, p); break;
+			case 6: DrawPartialSprite(x, y, &sprite, ox, oy, w % 20, h % 15, scale, flip); break;
+			case 7:		// Blitted, then drawn to
+				DrawSprite(x, y, &changed, scale, flip);
+				SetDrawTarget(&changed);
+				FillRect(ox, oy, w % 10, h % 10, p);
+				SetDrawTarget(layer);
+				break;
+			case 8:		// Blitted, then written directly
+				DrawPartialSprite(x, y, &changed, ox, oy, w % 20, h % 15, scale, flip);
+				changed.SetPixel(ox, oy, p);
+				break;
+			case 9: {	// Blitted and gone before the frame ends
+				olc::Sprite gone(1 + w % 30, 1 + h % 30);
+				fill(gone, rng);
+				DrawSprite(x, y, &gone, scale, flip);
+				break;
+			}
+			}
+		}
+
+		SetPixelMode(olc::Pixel::NORMAL);
+		SetPixelBlend(1.0f);
+	}
+
+public:
+
+	bool OnUserCreate() override {
+		Random rng(seed);
+		fill(sprite, rng);
+		CreateLayer();
+		CreateLayer();
+		SetLayerDeferred(2, true);
+		return true;
+	}
+
+	bool OnUserUpdate(float) override {
+
+		// Deferred draws land at the end of the frame, so the last frame's draws are compared
+		if (frame > 0) {
+			olc::Sprite* a = GetLayers()[1].pDrawTarget;
+			olc::Sprite* b = GetLayers()[2].pDrawTarget;
+			for (int i = 0; i < a->width * a->height; i++) {
+				if (a->GetData()[i] == b->GetData()[i]) continue;
+				if (failures++ < 5) std::cout << "frame " << frame - 1 << ": pixel (" << i % a->width << ", " << i / a->width << ") differs" << std::endl;
+				break;
+			}
+		}
+		if (frame == frames) return false;
+
+		for (uint8_t layer = 1; layer <= 2; layer++) {
+			Random rng(seed, uint64_t(frame));
+			draw(layer, rng);
+		}
+		frame++;
+		return true;
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	uint64_t seed	= argc > 1 ? std::stoull(argv[1]) : 1;
+	int frames		= argc > 2 ? std::stoi(argv[2]) : 1500;
+
+	DeferredLayerCheck check(seed, frames);
+	if (check.Construct(256, 160, 1, 1)) check.Start();
+	if (check.failures > 0) {
+		std::cout << check.failures << " of " << frames << " frames differ" << std::endl;
+		return 1;
+	}
+	std::cout << frames << " frames: the deferred layer matches the immediate one" << std::endl;
+	return 0;
+}
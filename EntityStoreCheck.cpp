@@ -0,0 +1,141 @@
+// Checks that the SIMD integrate() kernels give bit identical results to the scalar one
+// Random slots (plus the edge cases: speeds around the snap to zero at 5, speeds over the cap,
+// positions on and past every boundary) are stepped with every kernel and every array is compared.
+// Usage: EntityStoreCheck [seed] [steps]
+
+// Only the engine's types are needed, so it is built without a window
+#define OLC_PGE_APPLICATION
+#define OLC_PLATFORM_HEADLESS
+#include "olcPixelGameEngine.h"
+#include "./PixelGame/EntityStore.h"
+#include "./PixelGame/Random.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Slots that aren't a multiple of the SIMD width so the scalar tail is covered as well
+static const int slots = 1029;
+
+// Fills a store with slots seeded from 'seed', the same seed gives the same store
+// (draws only happen in braced lists or separate statements, which fixes their order)
+static void fill(EntityStore& store, uint64_t seed) {
+
+	Random rng(seed);
+	auto range = [&](float lo, float hi) { return lo + rng.unit() * (hi - lo); };
+	auto direction = [&]() { olc::vf2d d; d.x = range(-1, 1); d.y = range(-1, 1); return d.norm(); };
+
+	for (int i = 0; i < slots; i++) {
+
+		EntityStore::Boundary b = { range(0, 50), range(100, 300), range(0, 50), range(100, 300) };
+		olc::vf2d pos = { range(b.xLower, b.xUpper), range(b.yLower, b.yUpper) };
+		olc::vf2d vel = { range(-80, 80), range(-80, 80) };
+		float cap = range(10, 60);
+
+		switch (i % 8) {
+		case 0:		// Speed right around the snap to zero
+			vel = direction();
+			vel *= 5.0f + range(-0.01f, 0.01f);
+			break;
+		case 1:		// Exactly at it
+			vel = { 3.0f, 4.0f };
+			break;
+		case 2:		// Well over the speed cap
+			vel = direction();
+			vel *= cap * range(2, 10);
+			break;
+		case 3:		// On a boundary
+			pos = { rng.below(2) ? b.xLower : b.xUpper, rng.below(2) ? b.yLower : b.yUpper };
+			break;
+		case 4:		// Past one, heading further out
+			pos = { b.xLower - range(0, 5), b.yUpper + range(0, 5) };
+			vel = { -range(10, 50), range(10, 50) };
+			break;
+		case 5:		// Past the others
+			pos = { b.xUpper + range(0, 5), b.yLower - range(0, 5) };
+			break;
+		default:
+			break;
+		}
+
+		int id = store.create(pos, vel, range(50, 150));
+		store.setBoundary(id, b);
+		store.speedCap[id] = cap;
+		store.speed[id] = range(5, 20);
+		store.setDampen(id, range(0, 0.2f));
+		store.steerX[id] = rng.below(3) ? 0.0f : range(-20, 20);
+		store.steerY[id] = rng.below(3) ? 0.0f : range(-20, 20);
+
+		// Most slots are simulated, some take slow steps and some sit still
+		uint32_t flag = rng.below(8);
+		store.simulate[id] = flag < 5;
+		store.slow[id] = flag == 5;
+	}
+}
+
+// Index of the first float that differs bit for bit, -1 if there is none
+static int compare(const std::vector<float>& a, const std::vector<float>& b) {
+	for (size_t i = 0; i < a.size(); i++) {
+		if (memcmp(&a[i], &b[i], sizeof(float)) != 0) return int(i);
+	}
+	return -1;
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t seed	= argc > 1 ? std::stoull(argv[1]) : 1;
+	int steps		= argc > 2 ? std::stoi(argv[2]) : 600;
+
+	const char* names[] = { "auto", "scalar", "sse", "avx2" };
+	const EntityStore::Kernel kernels[] = { EntityStore::SCALAR, EntityStore::SSE, EntityStore::AVX2, EntityStore::AUTO };
+
+	// Every kernel steps its own copy of the same slots (full and slow steps, at a rate other than 60Hz so the damping is rescaled)
+	std::vector<EntityStore> stores(4);
+	for (int k = 0; k < 4; k++) {
+		fill(stores[k], seed);
+		stores[k].kernel = kernels[k];
+		stores[k].setStep(1.0f / 75.0f);
+		stores[k].setSlowSteps(4);
+	}
+
+	for (int step = 0; step < steps; step++) {
+		for (EntityStore& store : stores) {
+			store.integrate(1.0f / 75.0f, 0, store.size());
+			store.integrateSlow(4.0f / 75.0f, 0, store.size());
+
+			// Keep some steering coming so it is applied more than once
+			for (int i = step % 7; i < store.size(); i += 7) store.steerX[i] += 3.0f;
+		}
+	}
+
+	int failures = 0;
+	for (int k = 1; k < 4; k++) {
+		EntityStore& a = stores[0];
+		EntityStore& b = stores[k];
+		struct Array {
+			const char* name;
+			std::vector<float>& a;
+			std::vector<float>& b;
+		} arrays[] = {
+			{ "posX", a.posX, b.posX }, { "posY", a.posY, b.posY },
+			{ "velX", a.velX, b.velX }, { "velY", a.velY, b.velY },
+			{ "steerX", a.steerX, b.steerX }, { "steerY", a.steerY, b.steerY },
+			{ "prevX", a.prevX, b.prevX }, { "prevY", a.prevY, b.prevY },
+			{ "mass", a.mass, b.mass }, { "speedCap", a.speedCap, b.speedCap }, { "speed", a.speed, b.speed },
+			{ "dampen", a.dampen, b.dampen }, { "decay", a.decay, b.decay }, { "slowDecay", a.slowDecay, b.slowDecay },
+			{ "xLower", a.xLower, b.xLower }, { "xUpper", a.xUpper, b.xUpper },
+			{ "yLower", a.yLower, b.yLower }, { "yUpper", a.yUpper, b.yUpper }
+		};
+
+		for (Array& array : arrays) {
+			int i = compare(array.a, array.b);
+			if (i < 0) continue;
+			std::cout << names[kernels[k]] << ": " << array.name << "[" << i << "] is " << array.b[i] << ", scalar gives " << array.a[i] << std::endl;
+			failures++;
+		}
+	}
+
+	if (failures > 0) return 1;
+	std::cout << slots << " slots, " << steps << " steps: sse, avx2 and auto match scalar" << std::endl;
+	return 0;
+}
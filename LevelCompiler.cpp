@@ -0,0 +1,110 @@
+// Turns leveldata.json into one compiled level per entry (see PixelGame/LevelFormat.h)
+// and packs the sprites and sprite sheets into an atlas (see PixelGame/SpriteAtlas.h)
+// Both go into the level packs next to (or instead of) leveldata.json and the images
+// Usage: LevelCompiler [leveldata.json] [output directory] [images directory]
+
+// Only the engine's types are needed, so it is built without a window
+#define OLC_PGE_APPLICATION
+#define OLC_PLATFORM_HEADLESS
+#include "olcPixelGameEngine.h"
+#include "./PixelGame/LevelFormat.h"
+#include "./PixelGame/SpriteAtlas.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+
+int main(int argc, char* argv[])
+{
+	std::string input	= argc > 1 ? argv[1] : "./Assets/data/leveldata.json";
+	std::string output	= argc > 2 ? argv[2] : "./Assets/data";
+	std::string images	= argc > 3 ? argv[3] : "./Assets/images";
+
+	std::ifstream i(input, std::ifstream::binary);
+	if (!i.is_open()) {
+		std::cout << "Unable to open " << input << std::endl;
+		return 1;
+	}
+	std::string text((std::istreambuf_iterator<char>(i)), std::istreambuf_iterator<char>());
+
+	std::vector<LevelData> levels;
+	try {
+		levels = LevelFormat::fromJson(text.data(), text.size());
+	}
+	catch (std::exception& e) {
+		std::cout << "Unable to read " << input << ": " << e.what() << std::endl;
+		return 1;
+	}
+
+	for (LevelData& level : levels) {
+		try {
+			// Same name as in the pack, just somewhere else
+			std::string file = LevelFormat::path(level.number);
+			file = output + file.substr(file.find_last_of('/'));
+
+			std::ofstream o(file, std::ofstream::binary);
+			LevelFormat::write(level, o);
+			if (!o.good()) throw std::runtime_error("Unable to write " + file);
+
+			std::cout << file << ": " << level.npcs.size() << " npcs, " << level.skins.size() << " skins, " << level.animations.size() << " sheets, "
+				<< level.map.size() << " tiles" << std::endl;
+		}
+		catch (std::exception& e) {
+			std::cout << "Level " << level.number << ": " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	// Map images and tilesets are cut into tiles by the Tilemap, everything else goes into the atlas
+	std::set<std::string> maps;
+	for (LevelData& level : levels) {
+		maps.insert("./Assets/images/sprites/" + level.name + ".png");
+		maps.insert("./Assets/images/sprites/" + level.tileset + ".png");
+	}
+
+	// The engine sets up the image loader, there is no window to open
+	olc::PixelGameEngine engine;
+
+	// Keyed by the path the game loads them from, wherever the images are right now
+	std::vector<std::unique_ptr<olc::Sprite>> sprites;
+	std::vector<std::pair<std::string, olc::Sprite*>> packed;
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(images, error), end; !error && it != end; it.increment(error)) {
+		if (!it->is_regular_file() || it->path().extension() != ".png") continue;
+
+		std::string path = "./Assets/images/" + std::filesystem::relative(it->path(), images).generic_string();
+		if (maps.count(path)) continue;
+
+		sprites.push_back(std::make_unique<olc::Sprite>(it->path().string()));
+		if (sprites.back()->width == 0 || sprites.back()->height == 0) {
+			std::cout << "Unable to load " << it->path().string() << std::endl;
+			return 1;
+		}
+		packed.push_back({ path, sprites.back().get() });
+	}
+	if (error) {
+		std::cout << "Unable to read " << images << ": " << error.message() << std::endl;
+		return 1;
+	}
+
+	SpriteAtlas atlas = SpriteAtlas::pack(packed);
+	for (const std::pair<std::string, olc::Sprite*>& s : packed) {
+		if (!atlas.find(s.first)) std::cout << s.first << " is too big for the atlas, it keeps its own texture" << std::endl;
+	}
+
+	std::string file = SpriteAtlas::path();
+	file = output + file.substr(file.find_last_of('/'));
+	std::ofstream o(file, std::ofstream::binary);
+	atlas.write(o);
+	if (!o.good()) {
+		std::cout << "Unable to write " << file << std::endl;
+		return 1;
+	}
+
+	std::cout << file << ": " << atlas.spriteCount() << " sprites on " << atlas.pageCount() << " pages" << std::endl;
+	for (int i = 0; i < atlas.pageCount(); i++)
+		std::cout << "  page " << i << ": " << atlas.getPage(i)->width << "x" << atlas.getPage(i)->height << std::endl;
+
+	return 0;
+}
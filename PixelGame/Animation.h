@@ -1,110 +1,247 @@
 #pragma once
 
 #include "../olcPixelGameEngine.h"
+#include "Random.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <vector>
 #include <utility>
 
-class AnimationManager {
+// Clips of a sprite sheet, one clip per row with its frames left to right
+// Built once per sheet and shared (read only) by every entity that uses it. The position of
+// every frame is worked out up front, so finding the frame to draw is a lookup.
+class AnimationSheet {
+
+public:
+
+	struct Clip {
+		int first;		// Index of the clip's first frame in 'frames'
+		int count;
+	};
+
+	// Frame rate of sheets the level data doesn't give one
+	static constexpr float defaultFps = 7.5f;
+
+	olc::vf2d frameSize;
+	float frameTime;
+	std::vector<Clip> clips;
+
+	// Top left of every frame, clip after clip (relative to the sheet)
+	std::vector<olc::vf2d> frames;
+
 public:
-	AnimationManager(std::vector<int> animationCounts, int framesPerAnimation, olc::Decal* d)
-		: animations(animationCounts), decal(d)
+
+	// counts[i] frames in row i, there is always at least one clip of at least one frame
+	// (rates that aren't a positive number play at the default rate)
+	AnimationSheet(olc::vi2d frame, float fps, const std::vector<int>& counts)
+		: frameSize(olc::vf2d(frame)), frameTime(1.0f / (fps > 0.0f && std::isfinite(fps) ? fps : defaultFps))
 	{
-		target = float(framesPerAnimation) / 60;
-		numberOfAnimations = animationCounts.size();
+		for (int row = 0; row < std::max(1, int(counts.size())); row++) {
+			int count = row < int(counts.size()) ? std::max(1, counts[row]) : 1;
+			clips.push_back({ int(frames.size()), count });
+			for (int i = 0; i < count; i++) frames.push_back({ float(i * frame.x), float(row * frame.y) });
+		}
 	}
 
-	~AnimationManager()
-	{
-		delete decal;
+	// Frames in every row of the sheet at 'pos' (inside 'sprite'), up to the last one that isn't fully transparent
+	// Empty rows at the bottom aren't clips
+	static std::vector<int> countFrames(olc::Sprite* sprite, olc::vi2d pos, olc::vi2d size, olc::vi2d frame) {
+
+		std::vector<int> counts;
+		if (frame.x <= 0 || frame.y <= 0) return counts;
+
+		for (int row = 0; row < size.y / frame.y; row++) {
+			int count = 0;
+			for (int column = 0; column < size.x / frame.x; column++) {
+				bool visible = false;
+				for (int y = 0; y < frame.y && !visible; y++)
+					for (int x = 0; x < frame.x && !visible; x++)
+						visible = sprite->GetPixel(pos.x + column * frame.x + x, pos.y + row * frame.y + y).a != 0;
+				if (visible) count = column + 1;
+			}
+			counts.push_back(count);
+		}
+
+		while (!counts.empty() && counts.back() == 0) counts.pop_back();
+		return counts;
 	}
+};
+
+// Structure of arrays holding the animation state of every animated entity
+// Entities only keep an id, so the clocks of a whole crowd are advanced by one pass over
+// a few contiguous arrays (the same way EntityStore integrates them).
+// Clip 0 is the idle clip, an idle entity sits on its first frame and now and then plays it through.
+class AnimationSystem {
+
+public:
+
+	// 1 if the slot should be advanced by update() this step
+	std::vector<uint8_t> advance;
+
+	// Most frames a clock moves on in one update, the rest of the time is dropped
+	// (a huge rate or step can't keep an update going)
+	static constexpr int maxFrames = 64;
 
 private:
-	// Information about the animations
-	int numberOfAnimations;
-	float target;					// Determines when to increment the current frame
-	std::vector<int> animations;
-	const int spriteSize = 16;
-
-	// Current status
-	int currentFrame = 0;		// [0, nFrames-1]
-	int currentAnimation = 0;	// [0, numberOfAnimations.size()-1]
-	bool isPlaying = false;
-	bool isIdle = false;
-	int alpha = 1;
-	int accumulatedFrames = 0;
-	
-	// Accumulated total time
-	float accumulatedTime = 0.0f;
-
-	// Sprite and decal
-	olc::Decal* decal;
+
+	// Clip tables (kept alive by 'owners')
+	std::vector<const AnimationSheet*> sheet;
+	std::vector<std::shared_ptr<const AnimationSheet>> owners;
+
+	// Where the sheet is in the decal (sheets can be packed into an atlas)
+	std::vector<olc::vf2d> origin;
+
+	// Clock
+	std::vector<float> time;
+	std::vector<float> frameTime;
+
+	// Current clip (its first frame in the sheet and frame count) and frame in it
+	std::vector<int> clip, first, count, frame;
+
+	// Frames of the idle clip left to play
+	std::vector<int> pending;
+
+	std::vector<uint8_t> playing, idling;
+	std::vector<uint32_t> chance;		// 1/chance per frame that an idle entity plays the idle clip
+	std::vector<Random> rng;
+
+	// 1 if the slot is owned by an entity
+	std::vector<uint8_t> alive;
+
+	// Released slots that can be handed out again
+	std::vector<int> freeSlots;
 
 public:
 
-	// 1/alpha probability that animation-0 will play
-	void idle(int alpha) { 
-		if (isIdle) return;
-		isPlaying = false;
-		isIdle = true;
-		this->alpha = alpha;
+	// Reserve a slot playing the sheet's first clip, 'at' is where the sheet is in its decal
+	int create(std::shared_ptr<const AnimationSheet> s, olc::vf2d at, Random r) {
+
+		int id;
+		if (!freeSlots.empty()) {
+			id = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			id = size();
+			advance.push_back(0);
+			sheet.push_back(nullptr);
+			owners.emplace_back();
+			origin.emplace_back();
+			time.push_back(0.0f);
+			frameTime.push_back(0.0f);
+			clip.push_back(0);
+			first.push_back(0);
+			count.push_back(0);
+			frame.push_back(0);
+			pending.push_back(0);
+			playing.push_back(0);
+			idling.push_back(0);
+			chance.push_back(1);
+			rng.emplace_back();
+			alive.push_back(0);
+		}
+
+		advance[id] = 0;
+		sheet[id] = s.get();
+		owners[id] = std::move(s);
+		origin[id] = at;
+		time[id] = 0.0f;
+		frameTime[id] = sheet[id]->frameTime;
+		clip[id] = 0;
+		first[id] = sheet[id]->clips[0].first;
+		count[id] = sheet[id]->clips[0].count;
+		frame[id] = 0;
+		pending[id] = 0;
+		playing[id] = 0;
+		idling[id] = 0;
+		chance[id] = 1;
+		rng[id] = r;
+		alive[id] = 1;
+		return id;
 	}
-	void play() { 
-		if (isPlaying) return;
-		isPlaying = true; 
-		isIdle = false;
+
+	// Hand a slot back (the id must not be used afterwards)
+	void release(int id) {
+		alive[id] = 0;
+		advance[id] = 0;
+		owners[id].reset();
+		sheet[id] = nullptr;
+		freeSlots.push_back(id);
 	}
-	
-	// Update the current frame number
-	void updateAnimation(float elapsedTime) {
-		
-		accumulatedTime += elapsedTime;
-
-		if (accumulatedTime >= target) {
-			accumulatedTime = fmod(accumulatedTime, target);
-
-			if (isPlaying || accumulatedFrames > 0) {
-
-				if (isPlaying) {
-					currentFrame++;
-					currentFrame %= animations[currentAnimation];
-				}
-				else {
-					currentFrame = animations[currentAnimation] - accumulatedFrames;
-					accumulatedFrames--;
-				}
-			}
-			else {
-				currentFrame = 0;
-			}
 
-			if (isIdle && (rand() % alpha == 0) && accumulatedFrames <= 0) {
-				accumulatedFrames = animations[0];
-			}
-		}
+	// Number of slots (including released ones)
+	int size() { return int(alive.size()); }
+
+	// Clears every advance flag
+	void clearAdvance() { std::fill(advance.begin(), advance.end(), 0); }
+
+	// Switch clips (back to its first frame), clips the sheet doesn't have play clip 0
+	void select(int id, int c) {
+		int r = c < int(sheet[id]->clips.size()) ? c : 0;
+		if (r == clip[id]) return;
+		clip[id] = r;
+		first[id] = sheet[id]->clips[clip[id]].first;
+		count[id] = sheet[id]->clips[clip[id]].count;
+		frame[id] = 0;
+	}
+
+	// Loop the current clip
+	void play(int id) {
+		if (playing[id]) return;
+		playing[id] = 1;
+		idling[id] = 0;
 	}
 
-	// Choose which animation to play
-	void selectAnimation(int animationIndex) {
+	// Stop and play the idle clip through with a 1/n chance every frame
+	void idle(int id, uint32_t n) {
+		if (idling[id]) return;
+		playing[id] = 0;
+		idling[id] = 1;
+		chance[id] = n;
+	}
 
-		if (animationIndex != currentAnimation) {
-			currentAnimation = animationIndex < numberOfAnimations ? animationIndex : 0;
-			currentFrame = 0;
+	// Advances the clocks of every slot in [from, to) flagged in 'advance'
+	// Slots don't affect each other, so ranges that don't overlap can be advanced on different threads
+	void update(float elapsedTime, int from, int to) {
+		for (int i = from; i < to; i++) {
+			if (advance[i]) update(i, elapsedTime);
 		}
 	}
 
-	// Get the current decal to display
-	olc::Decal* getDecal()
-	{ 
-		return decal;
+	// Advances one slot's clock by a step
+	void update(int i, float elapsedTime) {
+
+		// One frame for every whole frame time the clock went past
+		time[i] += elapsedTime;
+		int frames = 0;
+		while (time[i] >= frameTime[i]) {
+			if (++frames > maxFrames) {
+				time[i] = 0.0f;
+				break;
+			}
+			time[i] -= frameTime[i];
+
+			if (playing[i]) {
+				frame[i] = frame[i] + 1 < count[i] ? frame[i] + 1 : 0;
+			}
+			else if (pending[i] > 0) {
+				frame[i] = std::max(0, count[i] - pending[i]);
+				pending[i]--;
+			}
+			else {
+				frame[i] = 0;
+			}
+
+			if (idling[i] && rng[i].chance(chance[i]) && pending[i] <= 0) pending[i] = sheet[i]->clips[0].count;
+		}
 	}
 
-	// We will need to index our sprite sheet for the current frame
-	// The row is the current animation and the column is the current frame
-	// void DrawPartialDecal(const olc::vf2d& pos, olc::Decal* decal, const olc::vf2d& source_pos, const olc::vf2d& source_size, const olc::vf2d& scale = { 1.0f,1.0f }, const olc::Pixel& tint = olc::WHITE);
-	std::pair<olc::vf2d, olc::vf2d> getPartialCoords()
-	{
-		olc::vf2d source_pos = { float(currentFrame * spriteSize), float(currentAnimation * spriteSize)};
-		olc::vf2d source_size = { float(spriteSize), float(spriteSize) };
-		return std::make_pair(source_pos, source_size);
+	// Where the current frame is in the decal and its size
+	std::pair<olc::vf2d, olc::vf2d> getPartialCoords(int id) {
+		return { origin[id] + sheet[id]->frames[first[id] + frame[id]], sheet[id]->frameSize };
 	}
-};
\ No newline at end of file
+
+	int getClip(int id) { return clip[id]; }
+	int getFrame(int id) { return frame[id]; }
+};
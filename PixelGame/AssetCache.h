@@ -0,0 +1,114 @@
+#pragma once
+#include "../olcPixelGameEngine.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Shared sprites and decals keyed by their resource path
+// Each path is decoded and uploaded once no matter how many entities use it.
+// The cache only keeps weak references, so the sprite and its texture are released
+// as soon as the last handle goes away. Sprites packed into an atlas (see SpriteAtlas)
+// are a region of the page's decal and keep the page alive instead.
+class AssetCache {
+
+public:
+
+	// Sprite and decal decoded from one file
+	struct Asset {
+		std::string path;
+		std::unique_ptr<olc::Sprite> sprite;
+		std::unique_ptr<olc::Decal> decal;
+
+		// Atlas page the sprite lives in (nothing of its own is uploaded then)
+		std::shared_ptr<Asset> page;
+
+		// Part of the decal that is this sprite
+		olc::vf2d source = { 0.0f, 0.0f };
+		olc::vf2d size = { 0.0f, 0.0f };
+
+		// What to draw (along with source and size)
+		olc::Decal* getDecal() { return page ? page->decal.get() : decal.get(); }
+	};
+
+	typedef std::shared_ptr<Asset> Handle;
+
+private:
+
+	std::unordered_map<std::string, std::weak_ptr<Asset>> assets;
+
+public:
+
+	// Returns the shared asset for the path, decoding it from the pack the first time it is requested
+	Handle load(const std::string& path, olc::ResourcePack* pack) {
+
+		auto it = assets.find(path);
+		if (it != assets.end()) {
+			if (Handle handle = it->second.lock()) return handle;
+		}
+
+		return insert(path, std::make_unique<olc::Sprite>(path, pack));
+	}
+
+	// Adds a sprite that has already been decoded (e.g. on a loader thread) and creates its decal
+	// If the path is still in use the existing asset is returned and the sprite is thrown away
+	Handle insert(const std::string& path, std::unique_ptr<olc::Sprite> sprite) {
+
+		auto it = assets.find(path);
+		if (it != assets.end()) {
+			if (Handle handle = it->second.lock()) return handle;
+		}
+
+		Handle handle = std::make_shared<Asset>();
+		handle->path = path;
+		handle->sprite = std::move(sprite);
+		handle->decal = std::make_unique<olc::Decal>(handle->sprite.get());
+		handle->size = { float(handle->sprite->width), float(handle->sprite->height) };
+		assets[path] = handle;
+
+		// Forget anything that has been released in the meantime
+		if (it == assets.end()) prune();
+
+		return handle;
+	}
+
+	// Adds a sprite that is a region of an atlas page inserted before
+	// If the path is still in use the existing asset is returned
+	Handle insert(const std::string& path, Handle page, olc::vi2d source, olc::vi2d size) {
+
+		auto it = assets.find(path);
+		if (it != assets.end()) {
+			if (Handle handle = it->second.lock()) return handle;
+		}
+
+		Handle handle = std::make_shared<Asset>();
+		handle->path = path;
+		handle->page = page;
+		handle->source = olc::vf2d(source);
+		handle->size = olc::vf2d(size);
+		assets[path] = handle;
+
+		if (it == assets.end()) prune();
+
+		return handle;
+	}
+
+	// Is the path loaded and still in use?
+	bool contains(const std::string& path) {
+		auto it = assets.find(path);
+		return it != assets.end() && !it->second.expired();
+	}
+
+	// Number of assets that are still in use
+	int size() {
+		prune();
+		return int(assets.size());
+	}
+
+	// Drop the entries of assets nobody is using anymore
+	void prune() {
+		for (auto it = assets.begin(); it != assets.end();) {
+			if (it->second.expired()) it = assets.erase(it);
+			else ++it;
+		}
+	}
+};
@@ -16,6 +16,7 @@ public:
 		// Offset of entities that should be print to the screen (based on change of position)
 		offset[x] = iOffset.x;
 		offset[y] = iOffset.y;
+		previous = iOffset;
 
 		accel = 1;
 		stopRadius = 7;
@@ -35,6 +36,7 @@ private:
 
 	olc::vf2d points[2];		// Bounding upper-left and lower-right
 	float offset[2];			// Offset x and y
+	olc::vf2d previous;			// Offsets before the last step
 
 	// These values should be set directly from the player to maintain a nice camera panning illusion
 	int stopRadius;	// Radius from the center where the camera should stop panning
@@ -60,11 +62,13 @@ public:
 	}
 
 	// Smoothy moves the camera based on how far the new point is from the center
-	void smooth(olc::vf2d newPos) {
+	// accel is the part of the distance closed per 60Hz step, 'steps' is how many of those this step is
+	void smooth(olc::vf2d newPos, float steps = 1.0f) {
 		olc::vf2d dist = (screenDim / 2) - newPos;
+		float a = steps == 1.0f ? accel : 1.0f - std::pow(1.0f - accel, steps);
 		if (dist.mag2() > stopRadius) {
-			offset[x] +=  dist.x * accel;
-			offset[y] +=  dist.y * accel;
+			offset[x] +=  dist.x * a;
+			offset[y] +=  dist.y * a;
 		}
 	}
 
@@ -108,4 +112,14 @@ public:
 	olc::vf2d getOffsets() {
 		return { offset[x], offset[y] };
 	}
+
+	// Remember the offsets before a step so frames in between can be drawn smoothly
+	void saveOffsets() {
+		previous = getOffsets();
+	}
+
+	// Offsets between the last two steps ([0, 1) of the way)
+	olc::vf2d getOffsets(float alpha) {
+		return previous + (getOffsets() - previous) * alpha;
+	}
 };
\ No newline at end of file
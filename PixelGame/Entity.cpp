@@ -1,137 +1,213 @@
 #include "Entity.h"
 
+EntityStore Entity::store;
+AnimationSystem Entity::animations;
+AssetCache Entity::assets;
+
 // Preferred constructor to initialize a entity with specific values
 Entity::Entity(olc::vf2d iPos, olc::vf2d iVel, Boundary b, float mass, Type t)
-	: pos(iPos),
-	vel(iVel),
-	b(b),
-	m(mass),
+	: id(store.create(iPos, iVel, mass)),
 	type(t)
-{ }
+{
+	store.setBoundary(id, b);
+}
 
 // Unknown boundaries (at the moment)
 Entity::Entity(olc::vf2d iPos, olc::vf2d iVel, float mass, Type t)
-	: pos(iPos),
-	vel(iVel),
-	m(mass),
+	: id(store.create(iPos, iVel, mass)),
 	type(t)
 { }
 
 // Default constructor (used for testing)
 Entity::Entity()
-	: pos({ 50.0f, 50.0f }),
-	vel({ 0.0f, 0.0f }),
-	b({ 0, 100, 0, 100 }),
-	m(100.0f), type(NONE)
+	: id(store.create({ 50.0f, 50.0f }, { 0.0f, 0.0f }, 100.0f)),
+	type(NONE)
 
 {
+	store.setBoundary(id, { 0, 100, 0, 100 });
 	this->setPhysics(100.0f, 50.0f, 0.05f);
 }
 
 // Destructor
 Entity::~Entity()
 {
-	// Release memory
-	delete am;
-	delete sprite;
-	delete decal;
+	// Release the animation slot (the skin is released with the last entity using it)
+	if (animation >= 0) animations.release(animation);
+
+	// Give the physics slot back
+	store.release(id);
 }
 
 // Getters
-Entity::Boundary Entity::getBoundary() { return b; }
+int Entity::getId() { return id; }
+Entity::Boundary Entity::getBoundary() { return store.getBoundary(id); }
 Entity::Type Entity::getType() { return type; }
-float Entity::getSpeed() { return speed; }
-olc::vf2d Entity::getPos() { return pos; }
-olc::vf2d Entity::getVel() { return vel; }
-float Entity::getMass() { return m; }
-olc::Decal* Entity::getDecal() { return decal; };
+float Entity::getSpeed() { return store.speed[id]; }
+olc::vf2d Entity::getPos() { return { store.posX[id], store.posY[id] }; }
+olc::vf2d Entity::getRenderPos(float alpha) { return store.interpolate(id, alpha); }
+olc::vf2d Entity::getVel() { return { store.velX[id], store.velY[id] }; }
+float Entity::getMass() { return store.mass[id]; }
+olc::Decal* Entity::getDecal() { return skin ? skin->getDecal() : nullptr; };
+std::pair<olc::vf2d, olc::vf2d> Entity::getPartialCoords() {
+	if (animation >= 0) return animations.getPartialCoords(animation);
+	if (!skin) return { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+	return { skin->source, skin->size };
+}
 
 // Setters
-void Entity::setSpeed(float newSpeed) { speed = newSpeed; }
-void Entity::setSpeedCap(float newSpeedCap) { speedCap = newSpeedCap; }
-void Entity::setPos(olc::vf2d newPos) { pos = newPos; }
-void Entity::setVel(olc::vf2d newVel) { vel = newVel; }
-void Entity::setMass(float newMass) { m = newMass; }
-void Entity::increasePos(olc::vf2d deltaPos) { pos += deltaPos; }
-void Entity::increaseVel(olc::vf2d deltaVel) { vel += deltaVel; }
-void Entity::updateBoundary(Boundary newBoundary) { b = newBoundary; }
+void Entity::setSpeed(float newSpeed) { store.speed[id] = newSpeed; }
+void Entity::setSpeedCap(float newSpeedCap) { store.speedCap[id] = newSpeedCap; }
+void Entity::setPos(olc::vf2d newPos) { store.posX[id] = newPos.x; store.posY[id] = newPos.y; }
+void Entity::setVel(olc::vf2d newVel) { store.velX[id] = newVel.x; store.velY[id] = newVel.y; }
+void Entity::setMass(float newMass) { store.mass[id] = newMass; }
+void Entity::increasePos(olc::vf2d deltaPos) { store.posX[id] += deltaPos.x; store.posY[id] += deltaPos.y; }
+void Entity::increaseVel(olc::vf2d deltaVel) { store.velX[id] += deltaVel.x; store.velY[id] += deltaVel.y; }
+void Entity::increaseSteer(olc::vf2d deltaVel) { store.steerX[id] += deltaVel.x; store.steerY[id] += deltaVel.y; }
+void Entity::updateBoundary(Boundary newBoundary) { store.setBoundary(id, newBoundary); }
 void Entity::setDecal(std::string file, olc::ResourcePack* pack) {
-	sprite = new olc::Sprite(file, pack);
-	decal = new olc::Decal(sprite);
+	skin = assets.load(file, pack);
 }
+void Entity::setDecal(AssetCache::Handle newSkin) { skin = newSkin; }
 void Entity::setPhysics(float newSpeedCap, float newSpeed, float newDampen) {
-	speedCap = newSpeedCap;
-	speed = newSpeed;
-	dampen = newDampen;
+	store.speedCap[id] = newSpeedCap;
+	store.speed[id] = newSpeed;
+	store.setDampen(id, newDampen);
+}
+
+void Entity::seedRandom(uint64_t seed, uint64_t stream) {
+	rng.seed(seed, stream);
 }
 
 // Public functions
-void Entity::elasticCollision(std::unique_ptr<Entity>& e, olc::vf2d offsets) {
+std::pair<olc::vf2d, olc::vf2d> Entity::getPath(olc::vf2d offsets, olc::vf2d prevOffsets) {
 
-	olc::vf2d posA, posB;
+	olc::vf2d from = { store.prevX[id], store.prevY[id] };
+	olc::vf2d to = this->getPos();
 
-	// Remove offset from entity to determine if there is a collision
-	if (this->getType() == PLAYER) {
-		posA = pos;
-		posB = e->pos + offsets;
+	// Remove the camera from the player's positions
+	if (type == PLAYER) {
+		from -= prevOffsets;
+		to -= offsets;
 	}
-	else {	// Entities that are both offset do not need an offset correction (relative)
-		posA = pos;
-		posB = e->pos;
+
+	return { from, to };
+}
+float Entity::timeOfImpact(std::pair<olc::vf2d, olc::vf2d> a, std::pair<olc::vf2d, olc::vf2d> b, float radius) {
+
+	// Solve |d + v * t| = radius, with d and v the distance and motion of b relative to a
+	olc::vf2d d = b.first - a.first;
+	olc::vf2d v = (b.second - b.first) - (a.second - a.first);
+
+	float c = d.mag2() - radius * radius;
+	if (c <= 0) return 0;
+
+	float vv = v.mag2();
+	float dv = d.dot(v);
+	if (vv == 0 || dv >= 0) return -1;	// Not getting any closer
+
+	float disc = dv * dv - vv * c;
+	if (disc < 0) return -1;			// Passing each other
+
+	float t = (-dv - std::sqrt(disc)) / vv;
+	return t <= 1 ? t : -1;
+}
+void Entity::elasticCollision(std::unique_ptr<Entity>& e, olc::vf2d offsets, olc::vf2d prevOffsets, float elapsedTime) {
+
+	// Everything is worked out in map space
+	std::pair<olc::vf2d, olc::vf2d> pathA = this->getPath(offsets, prevOffsets);
+	std::pair<olc::vf2d, olc::vf2d> pathB = e->getPath(offsets, prevOffsets);
+
+	float t = timeOfImpact(pathA, pathB, e->r + r);
+	if (t < 0) return;
+
+	olc::vf2d posA, posB;
+	if (t > 0) {
+		// They touched during the step, go back to where that happened
+		posA = pathA.first + (pathA.second - pathA.first) * t;
+		posB = pathB.first + (pathB.second - pathB.first) * t;
+	}
+	else {
+		// Already overlapping at the start, resolve where they are now
+		posA = pathA.second;
+		posB = pathB.second;
+		if ((posB - posA).mag() >= (e->r + r)) return;
 	}
 
-	// If the two entities have collided
-	if ((posB - posA).mag() < (e->r + r)) {
-
-		// Calculations for v1
-		float coeffA = (m - e->m) / (m + e->m);
-		float coeffB = (2 * e->m) / (m + e->m);
-		olc::vf2d result1 = (vel * coeffA) + (e->vel * coeffB);
-
-		// Calculations for v2
-		coeffA = (2 * m) / (m + e->m);
-		coeffB = (e->m - m) / (m + e->m);
-		olc::vf2d result2 = (vel * coeffA) + (e->vel * coeffB);
-
-		// Apply velocities from collision
-		vel = result1;
-		e->vel = result2;
-
-		// Player collisions have an offset that needs to be addressed
-		if (this->getType() == PLAYER) {
-			// Calculate player with offsets since the entities are offset
-			pos = posB + ((posA - posB).norm() * (r + e->r));
-
-			// Remove offsets from both player position and entity position
-			// since everything is relative to an offset origin
-			posA -= offsets;
-			posB -= offsets;
-			e->pos = posA + ((posB - posA).norm() * (r + e->r));
-		}
-		else {
-			// Entity to entity interactions are all relative anyway
-			pos = posB + ((posA - posB).norm() * (r + e->r));
-			e->pos = posA + ((posB - posA).norm() * (r + e->r));
-		}
+	float m = this->getMass();
+	float eM = e->getMass();
+	olc::vf2d vel = this->getVel();
+	olc::vf2d eVel = e->getVel();
+
+	// Calculations for v1
+	float coeffA = (m - eM) / (m + eM);
+	float coeffB = (2 * eM) / (m + eM);
+	olc::vf2d result1 = (vel * coeffA) + (eVel * coeffB);
+
+	// Calculations for v2
+	coeffA = (2 * m) / (m + eM);
+	coeffB = (eM - m) / (m + eM);
+	olc::vf2d result2 = (vel * coeffA) + (eVel * coeffB);
+
+	// Apply velocities from collision
+	this->setVel(result1);
+	e->setVel(result2);
+
+	if (t > 0) {
+		// Spend what's left of the step moving away from the contact
+		float remaining = (1 - t) * elapsedTime;
+		posA += result1 * remaining;
+		posB += result2 * remaining;
 	}
+	else {
+		// Push both apart (relative to the other one's position)
+		// Entities on top of each other (e.g. clamped into the same corner) are separated the way they came
+		olc::vf2d n = posA - posB;
+		if (n.mag2() == 0) n = pathA.first - pathB.first;
+		if (n.mag2() == 0) n = { 1, 0 };
+		n = n.norm();
+
+		olc::vf2d pushedA = posB + (n * (r + e->r));
+		posB = posA - (n * (r + e->r));
+		posA = pushedA;
+	}
+
+	// The player's position is relative to the camera
+	this->setPos(type == PLAYER ? posA + offsets : posA);
+	e->setPos(e->getType() == PLAYER ? posB + offsets : posB);
+
+	// Check collision with boundaries
+	this->collision();
+	e->collision();
 }
 void Entity::bounce(int a) {
 	switch (a)
 	{
 	case X:
-		vel.x = -vel.x;
+		store.velX[id] = -store.velX[id];
 		break;
 	case Y:
-		vel.y = -vel.y;
+		store.velY[id] = -store.velY[id];
 		break;
 	default:
 		break;
 	}
 }
-void Entity::initAnimations(std::vector<int> animationCounts, int framesPerAnimation)
+void Entity::setAnimation(std::shared_ptr<const AnimationSheet> sheet)
 {
-	am = new AnimationManager(animationCounts, framesPerAnimation, decal);
+	if (animation >= 0) {
+		animations.release(animation);
+		animation = -1;
+	}
+
+	// Frames are relative to where the skin is in its decal
+	olc::vf2d origin = getPartialCoords().first;
+	animation = animations.create(sheet, origin, rng.split());
 }
+int Entity::getAnimation() { return animation; }
+void Entity::selectAnimation(Clip c) { if (animation >= 0) animations.select(animation, c); }
+void Entity::playAnimation() { if (animation >= 0) animations.play(animation); }
+void Entity::idleAnimation(uint32_t chance) { if (animation >= 0) animations.idle(animation, chance); }
+void Entity::animate(float elapsedTime) { if (animation >= 0) animations.update(animation, elapsedTime); }
 
 // Virtual functions that will likely need to be overwritten for child classes
 void Entity::updatePosition(float elapsedTime) {
@@ -139,36 +215,21 @@ void Entity::updatePosition(float elapsedTime) {
 	// Various checks and adjustments to velocity
 	this->velDecay();
 	this->speedCheck();
+	store.applySteer(id);
 
-	pos += vel * elapsedTime;	// Update position
+	this->increasePos(this->getVel() * elapsedTime);	// Update position
 
 	this->collision();			// Check collision with boundary
 }
 void Entity::collision() {
 	// If the entity collides with a boundary
-	if (pos.x < b.xLower || pos.x > b.xUpper) {
-		pos.x < b.xLower ? pos.x = b.xLower : pos.x = b.xUpper;
-		this->bounce(X);
-	}
-	if (pos.y < b.yLower || pos.y > b.yUpper) {
-		pos.y < b.yLower ? pos.y = b.yLower : pos.y = b.yUpper;
-		this->bounce(Y);
-	}
+	store.bounce(id);
 }
 void Entity::speedCheck() {
-
-	if (vel.mag2() > speedCap * speedCap) {
-		vel = vel.norm() * speedCap;
-	}
-
+	store.speedCheck(id);
 }
 void Entity::velDecay() {
 
 	// Exponentially decrease speed when velocity is greater than 5 (smooth deceleration)
-	if (vel.mag2() > 25) {
-		vel -= vel * dampen;
-	}
-	else {
-		vel.y = vel.x = 0;
-	}
+	store.velDecay(id);
 }
\ No newline at end of file
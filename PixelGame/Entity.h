@@ -2,6 +2,9 @@
 #include "../olcPixelGameEngine.h"
 #include "Camera.h"
 #include "Animation.h"
+#include "EntityStore.h"
+#include "AssetCache.h"
+#include "Random.h"
 
 class Entity {
 
@@ -20,18 +23,18 @@ public:
 		NPC
 	};
 
-	// Maximum x and y boundaries
-	// Upper bound describes the largest value
-	// Lower bound describes the smallest value
-	struct Boundary {
-		// Each boundary for how far the object can travel
-		// Note that lower and upper refer to the integer values (not acutal position, this is inverted)
-		float xLower;
-		float xUpper;
-		float yLower;
-		float yUpper;
+	// Clips of a character's sprite sheet (one per row)
+	enum Clip {
+		IDLE,
+		WALK_RIGHT,
+		WALK_LEFT,
+		WALK_UP,
+		WALK_DOWN
 	};
 
+	// Maximum x and y boundaries (stored per axis in the EntityStore)
+	typedef EntityStore::Boundary Boundary;
+
 public:
 	// Preferred constructor to initialize a entity with specific values
 	Entity(olc::vf2d, olc::vf2d, Boundary, float, Type);
@@ -43,46 +46,60 @@ public:
 	Entity();
 
 	// Destructor
-	~Entity();
+	virtual ~Entity();
+
+	// Entities own their slot in the store, so they can't be copied
+	Entity(const Entity&) = delete;
+	Entity& operator=(const Entity&) = delete;
 
 public:
 	const float spriteSize = 16;
 	const float r = spriteSize / 2;
 
-	// Animations
-	AnimationManager* am;
+	// Physics state for every entity (pos, vel, mass, limiters and boundaries)
+	static EntityStore store;
+
+	// Animation state of every animated entity
+	static AnimationSystem animations;
+
+	// Sprites and decals shared between entities with the same skin
+	static AssetCache assets;
 
 private:
-	// Specific behavior (limiters)
-	// Public to allow each child class to manipulate these values directly
-	float speedCap;
-	float speed;
-	float dampen;
-
-	// General physics variables
-	olc::vf2d pos;
-	olc::vf2d vel;
-	float m;
-	
-	// General boundaries (use these to set the outer most limits of the entity)
-	Boundary b;
+	// Slot in the store holding this entity's physics state
+	int id;
+
+	// Slot in the animation system, -1 if the entity isn't animated
+	int animation = -1;
 
 	// Identifiers and flags
 	Type type;
 
-	olc::Sprite* sprite;
-	olc::Decal* decal;
+	// Shared skin (sprite and decal)
+	AssetCache::Handle skin;
+
+protected:
+	// Random numbers for this entity only (see seedRandom)
+	Random rng;
 
 public:
 	// Getters
+	int getId();
 	Boundary getBoundary();
 	Type getType();
 	float getSpeed();
 	olc::vf2d getPos();
 	olc::vf2d getVel();
+
+	// Position between the last two steps ([0, 1) of the way), what should be drawn
+	olc::vf2d getRenderPos(float);
+
 	float getMass();
 	olc::Decal* getDecal();
 
+	// Where the skin is in its decal (position and size), skins in an atlas share the decal
+	std::pair<olc::vf2d, olc::vf2d> getPartialCoords();
+
 	// Setters
 	void setSpeed(float);
 	void setSpeedCap(float);
@@ -91,16 +108,30 @@ public:
 	void setMass(float);
 	void increasePos(olc::vf2d);
 	void increaseVel(olc::vf2d);
+	void increaseSteer(olc::vf2d);
 	void setDecal(std::string, olc::ResourcePack*);
+	void setDecal(AssetCache::Handle);
 
 	// Change movement characteristics in one go
 	void setPhysics(float, float, float);
 
+	// Seed the entity's generator, usually with the level seed and a stream per entity
+	// Should be called before setAnimation() so the animations are seeded as well
+	void seedRandom(uint64_t, uint64_t);
+
 	// specify a different boundary
 	void updateBoundary(Boundary);
 
-	// Perfectly elastic collision between entities
-	void elasticCollision(std::unique_ptr<Entity>&, olc::vf2d);
+	// Where the entity started and ended the last step in map space
+	// Takes the camera offsets at the end and start of the step (the player lives in screen space)
+	std::pair<olc::vf2d, olc::vf2d> getPath(olc::vf2d, olc::vf2d);
+
+	// First time in [0, 1] two circles moving along these paths touch (0 if they start overlapping), -1 if they don't
+	static float timeOfImpact(std::pair<olc::vf2d, olc::vf2d>, std::pair<olc::vf2d, olc::vf2d>, float);
+
+	// Perfectly elastic collision between entities, swept over the last step
+	// Takes the camera offsets at the end and start of the step and the step's length
+	void elasticCollision(std::unique_ptr<Entity>&, olc::vf2d, olc::vf2d, float);
 
 	// Invert the velocity based on which boundary it bounces on
 	void bounce(int);
@@ -117,8 +148,19 @@ public:
 	// How should the movement of the entity be dictated
 	virtual void velDecay();
 
-	// Set up the animations for the entity
-	void initAnimations(std::vector<int>, int);
+	// Animate the skin with a sprite sheet's clips (call after setDecal(), the skin is the sheet)
+	void setAnimation(std::shared_ptr<const AnimationSheet>);
+
+	// Slot in the animation system, -1 if the entity isn't animated
+	int getAnimation();
+
+	// Control the animation (nothing happens if the entity isn't animated)
+	void selectAnimation(Clip);
+	void playAnimation();
+	void idleAnimation(uint32_t);
+
+	// Advance the animation by a step
+	void animate(float);
 };
 
 class Player : public Entity {
@@ -137,7 +179,7 @@ private:
 	// These should remain the same values as those set using cam->setPanningOptions()
 	// Changing these values independently between objects will have adverse effects on the illusion
 	const int stopRadius = 49;	// r^2 from the center where the player's pos should stop being adjusted
-	const float accel = 0.05f;	// How quickly should the player's position be corrected (0..1]
+	const float accel = 0.05f;	// How quickly should the player's position be corrected (0..1] per 60Hz step
 
 	// Player uses seperate map boundaries from 'b' since 'b' is used to 
 	// dictate how far from center the player should be able to move
@@ -187,15 +229,18 @@ public:
 private:
 
 	// Variables to assist with random movements
-	int moveTimerX, moveTimerY;
+	float moveTimerX, moveTimerY;	// Seconds of steering left on each axis
 	bool positiveX, positiveY;
-	const int alpha = 200;			// 1/alpha probability to move each frame
-	const int maxDist = 30;			// maximum distance that the npc can decide to move
+	const int alpha = 200;			// 1/alpha probability to move each 60Hz step
+	const int maxDist = 30;			// maximum distance that the npc can decide to move (in 60Hz steps of steering)
 
 public:
 	void updatePosition(float);
 
-private:
+	// Decide on random movements (applied as steering on the next integration step)
+	// Slow steps cover more than one step at once
+	void randMove(int steps = 1);
 
-	void randMove();
+	// Pick the clip for where the NPC is heading
+	void chooseAnimation();
 };
\ No newline at end of file
@@ -0,0 +1,360 @@
+#pragma once
+#include "../olcPixelGameEngine.h"
+#include "Entity.h"
+#include "SpatialHash.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Per step entity update split into phases that run across a worker pool
+// Every phase works on fixed size chunks of entities and anything produced per chunk is
+// merged in chunk order, so the step comes out bit identical no matter how many threads
+// (or which ones) did the work:
+//  - cull:        which entities are on screen (drawn) and which are near it (full rate)
+//  - integrate:   NPC steering and the EntityStore step, entities further away take a slow
+//                 step every few steps instead (staggered by index so the cost stays even)
+//  - animate:     animation frames
+//  - broadphase:  pairs whose paths touched during the step
+//  - resolve:     pairs are replayed in batches that share no entity, which gives exactly
+//                 the same result as resolving them one after the other
+//  - draw list:   decals to submit, in entity order
+class EntityPipeline {
+
+public:
+
+	// A decal (or the part of an atlas page that is the entity's skin) to submit for an entity
+	struct DrawItem {
+		int entity;
+		olc::vf2d pos;
+		olc::Decal* decal;
+		olc::vf2d source;
+		olc::vf2d size;
+	};
+
+	// Entities (or pairs) per job, fixed so the split doesn't depend on the number of threads
+	static constexpr int chunkSize = 256;
+
+	// Store (and animation) slots per job (a multiple of the widest SIMD block)
+	static constexpr int slotChunkSize = 1024;
+
+	// Player's side of a pair
+	static constexpr int playerIndex = -1;
+
+	// How an entity is stepped this step
+	enum Rate : uint8_t {
+		SKIP,		// Not this step
+		FULL,		// Near the screen, every step
+		SLOW		// Further away, slowSteps steps at once every slowSteps steps
+	};
+
+private:
+
+	struct Pair {
+		int a;		// Entity doing the resolving (or playerIndex)
+		int b;
+	};
+
+	olc::WorkerPool pool;
+
+	// 1 if the entity is on screen this frame
+	std::vector<uint8_t> active;
+
+	// 1 if the entity is near the screen (kept from step to step, see cull())
+	std::vector<uint8_t> nearScreen;
+
+	// Rate of every entity this step
+	std::vector<uint8_t> rate;
+
+	// Level of detail: entities within nearMargin of the screen run at the full rate and only go back
+	// to the slow rate once they are another 'hysteresis' further out, so they don't flip every step
+	int slowSteps = 4;
+	float nearMargin = 64.0f;
+	float hysteresis = 32.0f;
+
+	// Steps since the level started (picks whose slow step it is)
+	uint64_t stepCount = 0;
+
+	// 1 if the entity is touching the player
+	std::vector<uint8_t> nearPlayer;
+
+	// Pairs found per chunk, then all of them in order
+	std::vector<std::vector<Pair>> chunkPairs;
+	std::vector<float> chunkTravel, chunkSlowTravel;
+	std::vector<Pair> pairs;
+
+	// Pairs sorted by batch, batch b is [batchStart[b], batchStart[b + 1])
+	std::vector<int> batchOf;
+	std::vector<int> lastBatch;
+	std::vector<int> batchStart;
+	std::vector<Pair> batched;
+
+	// Decals per chunk, then all of them in entity order
+	std::vector<std::vector<DrawItem>> chunkDraws;
+	std::vector<DrawItem> draws;
+
+public:
+
+	EntityPipeline(uint32_t workers = std::max(1u, std::thread::hardware_concurrency()))
+		: pool(workers)
+	{ }
+
+	uint32_t workers() { return pool.Workers(); }
+	bool isActive(int i) { return active[i] != 0; }
+	bool isNear(int i) { return nearScreen[i] != 0; }
+	int pairCount() { return int(pairs.size()); }
+	int batchCount() { return int(batchStart.size()) - 1; }
+
+	// Steps a slow step covers (1 runs everything at the full rate) and how far around the screen is near
+	void setLod(int steps, float margin = 64.0f, float band = 32.0f) {
+		slowSteps = std::max(steps, 1);
+		nearMargin = std::max(margin, 0.0f);
+		hysteresis = std::max(band, 0.0f);
+	}
+
+	// Forget which entities were near (a new level)
+	void reset() {
+		nearScreen.clear();
+		stepCount = 0;
+	}
+
+	// Flags entities that overlap the screen and the ones near it
+	void cull(std::vector<std::unique_ptr<Entity>>& entities, olc::vf2d offsets, olc::vi2d screen) {
+
+		int n = int(entities.size());
+		active.assign(n, 0);
+		if (int(nearScreen.size()) != n) nearScreen.assign(n, 0);
+
+		parallelFor(n, chunkSize, [&](int, int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				olc::vf2d pos = entities[i]->getPos() + offsets;
+				float r = entities[i]->r;
+				active[i] = !(pos.x + r < 0 || pos.x - r > screen.x || pos.y + r < 0 || pos.y - r > screen.y);
+
+				// Coming closer than nearMargin makes it near, it has to get further than that plus the band to stop being near
+				float m = nearScreen[i] ? nearMargin + hysteresis + r : nearMargin + r;
+				nearScreen[i] = active[i] || !(pos.x + m < 0 || pos.x - m > screen.x || pos.y + m < 0 || pos.y - m > screen.y);
+			}
+		});
+	}
+
+	// NPCs pick their steering and every entity whose turn it is is stepped
+	// Near entities take a step, the rest take a slow step every slowSteps steps (a different slowSteps-th of them each step)
+	void integrate(std::vector<std::unique_ptr<Entity>>& entities, EntityStore& store, float elapsedTime) {
+
+		int n = int(entities.size());
+		rate.assign(n, SKIP);
+		int phase = int(stepCount++ % uint64_t(slowSteps));
+
+		store.setSlowSteps(slowSteps);
+		store.clearSimulate();
+		parallelFor(n, chunkSize, [&](int, int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				if (nearScreen[i]) rate[i] = FULL;
+				else if ((i + phase) % slowSteps == 0) rate[i] = SLOW;
+				else continue;
+
+				Entity* e = entities[i].get();
+				int steps = rate[i] == SLOW ? slowSteps : 1;
+				if (e->getType() == Entity::Type::NPC) {
+					static_cast<NPC*>(e)->randMove(steps);
+					(rate[i] == SLOW ? store.slow : store.simulate)[e->getId()] = 1;
+				}
+				else {
+					e->updatePosition(elapsedTime * steps);
+				}
+			}
+		});
+
+		// Update every NPC's position in one pass over the store (and another for the slow ones)
+		parallelFor(store.size(), slotChunkSize, [&](int, int begin, int end) {
+			store.integrate(elapsedTime, begin, end);
+			store.integrateSlow(elapsedTime * slowSteps, begin, end);
+		});
+	}
+
+	// Animated NPCs on screen pick their clip, then every flagged clock is advanced in one pass over the system
+	// (the player advances its own in updatePosition)
+	void animate(std::vector<std::unique_ptr<Entity>>& entities, AnimationSystem& animations, float elapsedTime) {
+
+		animations.clearAdvance();
+		parallelFor(int(entities.size()), chunkSize, [&](int, int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				Entity* e = entities[i].get();
+				if (!active[i] || e->getAnimation() < 0 || e->getType() != Entity::Type::NPC) continue;
+				static_cast<NPC*>(e)->chooseAnimation();
+				animations.advance[e->getAnimation()] = 1;
+			}
+		});
+
+		parallelFor(animations.size(), slotChunkSize, [&](int, int begin, int end) {
+			animations.update(elapsedTime, begin, end);
+		});
+	}
+
+	// Collects every pair whose paths touched during the step in the order they get resolved
+	// (the player first for each entity, then its neighbours, where pairs of two entities at the
+	// same rate belong to the lower index)
+	// Entities at the full rate are swept against everything around them that isn't on a slow step.
+	// Slow ones only check whether they overlap anything at the end of their slow step, so the long
+	// paths of slow steps don't make everyone else search further.
+	// The grid still holds where everything started the step, offsets are the camera's at the end and start of it
+	void broadphase(std::vector<std::unique_ptr<Entity>>& entities, SpatialHash& grid, Player& player, olc::vf2d offsets, olc::vf2d prevOffsets) {
+
+		int n = int(entities.size());
+		int chunks = (n + chunkSize - 1) / chunkSize;
+		if (int(chunkPairs.size()) < chunks) chunkPairs.resize(chunks);
+		chunkTravel.assign(chunks, 0.0f);
+		chunkSlowTravel.assign(chunks, 0.0f);
+
+		// Furthest anything moved (at each rate), an entity can be that far from the cell it is filed under
+		std::pair<olc::vf2d, olc::vf2d> playerPath = player.getPath(offsets, prevOffsets);
+		parallelFor(n, chunkSize, [&](int chunk, int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				if (rate[i] == SKIP) continue;
+				std::pair<olc::vf2d, olc::vf2d> path = entities[i]->getPath(offsets, prevOffsets);
+				float& t = rate[i] == FULL ? chunkTravel[chunk] : chunkSlowTravel[chunk];
+				t = std::max(t, (path.second - path.first).mag());
+			}
+		});
+		float travel = (playerPath.second - playerPath.first).mag();
+		for (float t : chunkTravel) travel = std::max(travel, t);
+		float slowTravel = travel;
+		for (float t : chunkSlowTravel) slowTravel = std::max(slowTravel, t);
+
+		// Everything along a path (plus how far the others could have moved)
+		auto around = [&](std::pair<olc::vf2d, olc::vf2d> path, float margin, auto f) {
+			olc::vf2d lo = path.first.min(path.second) - olc::vf2d(margin, margin);
+			olc::vf2d hi = path.first.max(path.second) + olc::vf2d(margin, margin);
+			grid.query(lo, hi, f);
+		};
+
+		nearPlayer.assign(n, 0);
+		around(playerPath, travel, [&](int j) {
+			if (rate[j] == FULL && Entity::timeOfImpact(playerPath, entities[j]->getPath(offsets, prevOffsets), player.r + entities[j]->r) >= 0)
+				nearPlayer[j] = 1;
+		});
+
+		parallelFor(n, chunkSize, [&](int chunk, int begin, int end) {
+			std::vector<Pair>& out = chunkPairs[chunk];
+			out.clear();
+			for (int i = begin; i < end; i++) {
+				if (rate[i] == SKIP) continue;
+
+				if (nearPlayer[i]) out.push_back({ playerIndex, i });
+
+				std::pair<olc::vf2d, olc::vf2d> path = entities[i]->getPath(offsets, prevOffsets);
+				float r = entities[i]->r;
+				if (rate[i] == FULL) {
+					around(path, travel, [&](int j) {
+						if (j == i || rate[j] == SLOW || (rate[j] == FULL && j < i)) return;
+						if (Entity::timeOfImpact(path, entities[j]->getPath(offsets, prevOffsets), r + entities[j]->r) >= 0)
+							out.push_back({ i, j });
+					});
+				}
+				else {
+					olc::vf2d pos = path.second;
+					around({ pos, pos }, slowTravel, [&](int j) {
+						if (j == i || (rate[j] == SLOW && j < i)) return;
+						if ((entities[j]->getPos() - pos).mag2() < (r + entities[j]->r) * (r + entities[j]->r))
+							out.push_back({ i, j });
+					});
+				}
+			}
+		});
+
+		pairs.clear();
+		for (int c = 0; c < chunks; c++) pairs.insert(pairs.end(), chunkPairs[c].begin(), chunkPairs[c].end());
+	}
+
+	// Resolves the pairs from broadphase() at their earliest contact
+	// (pairs of a slow entity and one that wasn't stepped at the full rate have the whole slow step to move apart in)
+	void resolve(std::vector<std::unique_ptr<Entity>>& entities, Player& player, olc::vf2d offsets, olc::vf2d prevOffsets, float elapsedTime) {
+
+		int n = int(entities.size());
+		int count = int(pairs.size());
+
+		// A pair goes into the batch after the last one that used either of its entities,
+		// so pairs that share an entity keep their order and pairs in a batch are independent
+		lastBatch.assign(n + 1, -1);
+		batchOf.resize(count);
+		int batches = 0;
+		for (int p = 0; p < count; p++) {
+			int& a = lastBatch[pairs[p].a == playerIndex ? n : pairs[p].a];
+			int& b = lastBatch[pairs[p].b];
+			batchOf[p] = std::max(a, b) + 1;
+			a = b = batchOf[p];
+			batches = std::max(batches, batchOf[p] + 1);
+		}
+
+		// Stable counting sort by batch
+		batchStart.assign(batches + 1, 0);
+		for (int p = 0; p < count; p++) batchStart[batchOf[p] + 1]++;
+		for (int b = 0; b < batches; b++) batchStart[b + 1] += batchStart[b];
+		batched.resize(count);
+		std::vector<int>& cursor = lastBatch;
+		cursor.assign(batchStart.begin(), batchStart.end());
+		for (int p = 0; p < count; p++) batched[cursor[batchOf[p]]++] = pairs[p];
+
+		for (int b = 0; b < batches; b++) {
+			int first = batchStart[b];
+			parallelFor(batchStart[b + 1] - first, chunkSize, [&](int, int begin, int end) {
+				for (int p = first + begin; p < first + end; p++) {
+					const Pair& pair = batched[p];
+					Entity* e = pair.a == playerIndex ? &player : entities[pair.a].get();
+					float step = pair.a != playerIndex && rate[pair.a] == SLOW && rate[pair.b] != FULL ? elapsedTime * slowSteps : elapsedTime;
+					e->elasticCollision(entities[pair.b], offsets, prevOffsets, step);
+				}
+			});
+		}
+	}
+
+	// Files every entity that could have moved this step (stepped or pushed) under its new cell
+	void updateGrid(std::vector<std::unique_ptr<Entity>>& entities, SpatialHash& grid) {
+		int n = int(entities.size());
+		for (int i = 0; i < n; i++) {
+			if (rate[i] != SKIP) grid.update(i, entities[i]->getPos());
+		}
+		for (const Pair& pair : pairs) grid.update(pair.b, entities[pair.b]->getPos());
+	}
+
+	// Decals of every active entity in entity order, alpha picks the position between the last two steps
+	const std::vector<DrawItem>& buildDrawList(std::vector<std::unique_ptr<Entity>>& entities, olc::vf2d offsets, float alpha) {
+
+		int n = int(entities.size());
+		int chunks = (n + chunkSize - 1) / chunkSize;
+		if (int(chunkDraws.size()) < chunks) chunkDraws.resize(chunks);
+
+		parallelFor(n, chunkSize, [&](int chunk, int begin, int end) {
+			std::vector<DrawItem>& out = chunkDraws[chunk];
+			out.clear();
+			for (int i = begin; i < end; i++) {
+				if (!active[i]) continue;
+				Entity* e = entities[i].get();
+				std::pair<olc::vf2d, olc::vf2d> part = e->getPartialCoords();
+				out.push_back({ i, e->getRenderPos(alpha) - olc::vf2d(e->r, e->r) + offsets, e->getDecal(), part.first, part.second });
+			}
+		});
+
+		draws.clear();
+		for (int c = 0; c < chunks; c++) draws.insert(draws.end(), chunkDraws[c].begin(), chunkDraws[c].end());
+		return draws;
+	}
+
+private:
+
+	// Calls f(chunk, begin, end) for fixed size chunks of [0, n) across the pool
+	// A single chunk runs right here, waking the workers isn't worth it
+	template<typename F>
+	void parallelFor(int n, int size, F f) {
+		if (n <= 0) return;
+		int chunks = (n + size - 1) / size;
+		if (chunks == 1) {
+			f(0, 0, n);
+			return;
+		}
+		pool.Run(uint32_t(chunks), [&](uint32_t chunk, uint32_t) {
+			int begin = int(chunk) * size;
+			f(int(chunk), begin, std::min(n, begin + size));
+		});
+	}
+};
@@ -0,0 +1,385 @@
+#include "EntityStore.h"
+
+#if defined(ENTITYSTORE_SIMD)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+// Checks once whether the cpu (and the os) can run the AVX2 kernel
+static bool cpuHasAVX2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	// AVX needs to be supported by the cpu and its registers saved by the os
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28))) return false;
+	if ((_xgetbv(0) & 6) != 6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// The kernels below do exactly the same float operations as the scalar
+// integrate(id, dt) in the same order (no fused multiply-add, real sqrt and divide)
+// so simulated lanes end up bit identical to the scalar path.
+
+// Integrates blocks of 4 slots starting at 'first' (the ones flagged in 'simulate', damped by 'decay'), returns where it stopped
+static int integrateSSE(EntityStore& s, const uint8_t* simulate, const float* decay, int first, int n, float dt) {
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minSpeed2 = _mm_set1_ps(25.0f);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 step = _mm_set1_ps(dt);
+	const __m128i zeroi = _mm_setzero_si128();
+
+	// Bitwise select (mask ? a : b)
+	auto select = [](__m128 mask, __m128 a, __m128 b) {
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	};
+
+	int i = first;
+	for (; i + 4 <= n; i += 4) {
+
+		// Skip blocks without anything to simulate (off screen crowds)
+		int32_t flags;
+		memcpy(&flags, &simulate[i], sizeof(flags));
+		if (flags == 0) continue;
+
+		__m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(flags), zeroi), zeroi);
+		__m128 active = _mm_castsi128_ps(_mm_cmpgt_epi32(wide, zeroi));
+
+		__m128 px = _mm_loadu_ps(&s.posX[i]);
+		__m128 py = _mm_loadu_ps(&s.posY[i]);
+		__m128 vx = _mm_loadu_ps(&s.velX[i]);
+		__m128 vy = _mm_loadu_ps(&s.velY[i]);
+		__m128 sx = _mm_loadu_ps(&s.steerX[i]);
+		__m128 sy = _mm_loadu_ps(&s.steerY[i]);
+		__m128 cap = _mm_loadu_ps(&s.speedCap[i]);
+		__m128 damp = _mm_loadu_ps(&decay[i]);
+
+		// Velocity decay (snap to zero below a speed of 5 unless it is being steered)
+		__m128 mag2 = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+		__m128 steered = _mm_or_ps(_mm_cmpneq_ps(sx, zero), _mm_cmpneq_ps(sy, zero));
+		__m128 moving = _mm_or_ps(_mm_cmpgt_ps(mag2, minSpeed2), steered);
+		__m128 nvx = _mm_and_ps(moving, _mm_sub_ps(vx, _mm_mul_ps(vx, damp)));
+		__m128 nvy = _mm_and_ps(moving, _mm_sub_ps(vy, _mm_mul_ps(vy, damp)));
+
+		// Speed cap
+		mag2 = _mm_add_ps(_mm_mul_ps(nvx, nvx), _mm_mul_ps(nvy, nvy));
+		__m128 over = _mm_cmpgt_ps(mag2, _mm_mul_ps(cap, cap));
+		__m128 r = _mm_div_ps(one, _mm_sqrt_ps(mag2));
+		nvx = select(over, _mm_mul_ps(_mm_mul_ps(nvx, r), cap), nvx);
+		nvy = select(over, _mm_mul_ps(_mm_mul_ps(nvy, r), cap), nvy);
+
+		// Steering
+		nvx = _mm_add_ps(nvx, sx);
+		nvy = _mm_add_ps(nvy, sy);
+
+		// Position
+		__m128 npx = _mm_add_ps(px, _mm_mul_ps(nvx, step));
+		__m128 npy = _mm_add_ps(py, _mm_mul_ps(nvy, step));
+
+		// Boundary bounce
+		__m128 lo = _mm_loadu_ps(&s.xLower[i]);
+		__m128 hi = _mm_loadu_ps(&s.xUpper[i]);
+		__m128 below = _mm_cmplt_ps(npx, lo);
+		__m128 hit = _mm_or_ps(below, _mm_cmpgt_ps(npx, hi));
+		npx = select(hit, select(below, lo, hi), npx);
+		nvx = select(hit, _mm_xor_ps(nvx, sign), nvx);
+
+		lo = _mm_loadu_ps(&s.yLower[i]);
+		hi = _mm_loadu_ps(&s.yUpper[i]);
+		below = _mm_cmplt_ps(npy, lo);
+		hit = _mm_or_ps(below, _mm_cmpgt_ps(npy, hi));
+		npy = select(hit, select(below, lo, hi), npy);
+		nvy = select(hit, _mm_xor_ps(nvy, sign), nvy);
+
+		// Only write back the lanes that are being simulated
+		_mm_storeu_ps(&s.posX[i], select(active, npx, px));
+		_mm_storeu_ps(&s.posY[i], select(active, npy, py));
+		_mm_storeu_ps(&s.velX[i], select(active, nvx, vx));
+		_mm_storeu_ps(&s.velY[i], select(active, nvy, vy));
+		_mm_storeu_ps(&s.steerX[i], select(active, zero, sx));
+		_mm_storeu_ps(&s.steerY[i], select(active, zero, sy));
+	}
+
+	return i;
+}
+
+// Same as integrateSSE with blocks of 8 slots
+AVX2_TARGET static int integrateAVX2(EntityStore& s, const uint8_t* simulate, const float* decay, int first, int n, float dt) {
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 minSpeed2 = _mm256_set1_ps(25.0f);
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 step = _mm256_set1_ps(dt);
+
+	int i = first;
+	for (; i + 8 <= n; i += 8) {
+
+		// Skip blocks without anything to simulate (off screen crowds)
+		int64_t flags;
+		memcpy(&flags, &simulate[i], sizeof(flags));
+		if (flags == 0) continue;
+
+		__m256i wide = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&simulate[i]));
+		__m256 active = _mm256_castsi256_ps(_mm256_cmpgt_epi32(wide, _mm256_setzero_si256()));
+
+		__m256 px = _mm256_loadu_ps(&s.posX[i]);
+		__m256 py = _mm256_loadu_ps(&s.posY[i]);
+		__m256 vx = _mm256_loadu_ps(&s.velX[i]);
+		__m256 vy = _mm256_loadu_ps(&s.velY[i]);
+		__m256 sx = _mm256_loadu_ps(&s.steerX[i]);
+		__m256 sy = _mm256_loadu_ps(&s.steerY[i]);
+		__m256 cap = _mm256_loadu_ps(&s.speedCap[i]);
+		__m256 damp = _mm256_loadu_ps(&decay[i]);
+
+		// Velocity decay (snap to zero below a speed of 5 unless it is being steered)
+		__m256 mag2 = _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy));
+		__m256 steered = _mm256_or_ps(_mm256_cmp_ps(sx, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(sy, zero, _CMP_NEQ_UQ));
+		__m256 moving = _mm256_or_ps(_mm256_cmp_ps(mag2, minSpeed2, _CMP_GT_OQ), steered);
+		__m256 nvx = _mm256_and_ps(moving, _mm256_sub_ps(vx, _mm256_mul_ps(vx, damp)));
+		__m256 nvy = _mm256_and_ps(moving, _mm256_sub_ps(vy, _mm256_mul_ps(vy, damp)));
+
+		// Speed cap
+		mag2 = _mm256_add_ps(_mm256_mul_ps(nvx, nvx), _mm256_mul_ps(nvy, nvy));
+		__m256 over = _mm256_cmp_ps(mag2, _mm256_mul_ps(cap, cap), _CMP_GT_OQ);
+		__m256 r = _mm256_div_ps(one, _mm256_sqrt_ps(mag2));
+		nvx = _mm256_blendv_ps(nvx, _mm256_mul_ps(_mm256_mul_ps(nvx, r), cap), over);
+		nvy = _mm256_blendv_ps(nvy, _mm256_mul_ps(_mm256_mul_ps(nvy, r), cap), over);
+
+		// Steering
+		nvx = _mm256_add_ps(nvx, sx);
+		nvy = _mm256_add_ps(nvy, sy);
+
+		// Position
+		__m256 npx = _mm256_add_ps(px, _mm256_mul_ps(nvx, step));
+		__m256 npy = _mm256_add_ps(py, _mm256_mul_ps(nvy, step));
+
+		// Boundary bounce
+		__m256 lo = _mm256_loadu_ps(&s.xLower[i]);
+		__m256 hi = _mm256_loadu_ps(&s.xUpper[i]);
+		__m256 below = _mm256_cmp_ps(npx, lo, _CMP_LT_OQ);
+		__m256 hit = _mm256_or_ps(below, _mm256_cmp_ps(npx, hi, _CMP_GT_OQ));
+		npx = _mm256_blendv_ps(npx, _mm256_blendv_ps(hi, lo, below), hit);
+		nvx = _mm256_blendv_ps(nvx, _mm256_xor_ps(nvx, sign), hit);
+
+		lo = _mm256_loadu_ps(&s.yLower[i]);
+		hi = _mm256_loadu_ps(&s.yUpper[i]);
+		below = _mm256_cmp_ps(npy, lo, _CMP_LT_OQ);
+		hit = _mm256_or_ps(below, _mm256_cmp_ps(npy, hi, _CMP_GT_OQ));
+		npy = _mm256_blendv_ps(npy, _mm256_blendv_ps(hi, lo, below), hit);
+		nvy = _mm256_blendv_ps(nvy, _mm256_xor_ps(nvy, sign), hit);
+
+		// Only write back the lanes that are being simulated
+		_mm256_storeu_ps(&s.posX[i], _mm256_blendv_ps(px, npx, active));
+		_mm256_storeu_ps(&s.posY[i], _mm256_blendv_ps(py, npy, active));
+		_mm256_storeu_ps(&s.velX[i], _mm256_blendv_ps(vx, nvx, active));
+		_mm256_storeu_ps(&s.velY[i], _mm256_blendv_ps(vy, nvy, active));
+		_mm256_storeu_ps(&s.steerX[i], _mm256_blendv_ps(sx, zero, active));
+		_mm256_storeu_ps(&s.steerY[i], _mm256_blendv_ps(sy, zero, active));
+	}
+
+	return i;
+}
+#endif
+
+// Slot management
+int EntityStore::create(olc::vf2d pos, olc::vf2d vel, float m) {
+
+	int id;
+
+	// Reuse a released slot if there is one
+	if (!freeSlots.empty()) {
+		id = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		id = int(alive.size());
+
+		posX.push_back(0); posY.push_back(0);
+		prevX.push_back(0); prevY.push_back(0);
+		velX.push_back(0); velY.push_back(0);
+		steerX.push_back(0); steerY.push_back(0);
+		mass.push_back(0);
+		speedCap.push_back(0); speed.push_back(0); dampen.push_back(0); decay.push_back(0); slowDecay.push_back(0);
+		xLower.push_back(0); xUpper.push_back(0);
+		yLower.push_back(0); yUpper.push_back(0);
+		simulate.push_back(0); slow.push_back(0);
+		alive.push_back(0);
+	}
+
+	posX[id] = prevX[id] = pos.x; posY[id] = prevY[id] = pos.y;
+	velX[id] = vel.x; velY[id] = vel.y;
+	steerX[id] = steerY[id] = 0;
+	mass[id] = m;
+	speedCap[id] = speed[id] = dampen[id] = decay[id] = slowDecay[id] = 0;
+	xLower[id] = xUpper[id] = yLower[id] = yUpper[id] = 0;
+	simulate[id] = slow[id] = 0;
+	alive[id] = 1;
+
+	return id;
+}
+void EntityStore::release(int id) {
+	if (id < 0 || id >= size() || !alive[id]) return;
+	alive[id] = 0;
+	simulate[id] = slow[id] = 0;
+	freeSlots.push_back(id);
+}
+int EntityStore::size() { return int(alive.size()); }
+void EntityStore::clearSimulate() {
+	std::fill(simulate.begin(), simulate.end(), 0);
+	std::fill(slow.begin(), slow.end(), 0);
+}
+
+// Boundaries
+EntityStore::Boundary EntityStore::getBoundary(int id) {
+	return { xLower[id], xUpper[id], yLower[id], yUpper[id] };
+}
+void EntityStore::setBoundary(int id, Boundary b) {
+	xLower[id] = b.xLower;
+	xUpper[id] = b.xUpper;
+	yLower[id] = b.yLower;
+	yUpper[id] = b.yUpper;
+}
+
+// Step dependent damping
+// dampen is what's lost per reference step, losing it n times per reference step
+// means losing 1 - (1 - dampen)^(1 / n) each time
+static float stepDecay(float dampen, float step) {
+	if (step == EntityStore::referenceStep) return dampen;
+	return 1.0f - std::pow(1.0f - dampen, step / EntityStore::referenceStep);
+}
+void EntityStore::setStep(float elapsedTime) {
+	if (elapsedTime == step) return;
+	step = elapsedTime;
+	for (int id = 0; id < size(); id++) {
+		decay[id] = stepDecay(dampen[id], step);
+		slowDecay[id] = stepDecay(dampen[id], step * slowSteps);
+	}
+}
+void EntityStore::setDampen(int id, float d) {
+	dampen[id] = d;
+	decay[id] = stepDecay(d, step);
+	slowDecay[id] = stepDecay(d, step * slowSteps);
+}
+float EntityStore::getStep() { return step; }
+float EntityStore::stepRatio() { return step / referenceStep; }
+float EntityStore::perStep(float fraction) { return stepDecay(fraction, step); }
+void EntityStore::setSlowSteps(int steps) {
+	steps = std::max(steps, 1);
+	if (steps == slowSteps) return;
+	slowSteps = steps;
+	for (int id = 0; id < size(); id++) slowDecay[id] = stepDecay(dampen[id], step * slowSteps);
+}
+
+// Interpolation
+void EntityStore::savePositions() {
+	prevX = posX;
+	prevY = posY;
+}
+olc::vf2d EntityStore::interpolate(int id, float alpha) {
+	return {
+		prevX[id] + (posX[id] - prevX[id]) * alpha,
+		prevY[id] + (posY[id] - prevY[id]) * alpha
+	};
+}
+
+// Integration
+void EntityStore::integrate(float elapsedTime) {
+	integrate(elapsedTime, 0, size());
+}
+void EntityStore::integrate(float elapsedTime, int first, int last) {
+	integrate(simulate, decay, elapsedTime, first, last);
+}
+void EntityStore::integrate(int id, float elapsedTime) {
+	integrate(id, elapsedTime, decay[id]);
+}
+void EntityStore::integrateSlow(float elapsedTime, int first, int last) {
+	integrate(slow, slowDecay, elapsedTime, first, last);
+}
+void EntityStore::integrate(const std::vector<uint8_t>& flags, const std::vector<float>& rates, float elapsedTime, int first, int last) {
+
+	int n = std::min(last, size());
+	int id = first;
+
+#if defined(ENTITYSTORE_SIMD)
+	static const bool hasAVX2 = cpuHasAVX2();
+
+	// Widest kernel first, the next one picks up the remainder
+	if (hasAVX2 && (kernel == AUTO || kernel == AVX2))
+		id = integrateAVX2(*this, flags.data(), rates.data(), id, n, elapsedTime);
+	if (kernel != SCALAR)
+		id = integrateSSE(*this, flags.data(), rates.data(), id, n, elapsedTime);
+#endif
+
+	// Scalar fallback (and tail that doesn't fill a whole block)
+	for (; id < n; id++) {
+		if (!flags[id]) continue;
+		integrate(id, elapsedTime, rates[id]);
+	}
+}
+void EntityStore::integrate(int id, float elapsedTime, float rate) {
+
+	// Various checks and adjustments to velocity
+	velDecay(id, rate);
+	speedCheck(id);
+	applySteer(id);
+
+	// Update position
+	posX[id] += velX[id] * elapsedTime;
+	posY[id] += velY[id] * elapsedTime;
+
+	bounce(id);		// Check collision with boundary
+}
+void EntityStore::velDecay(int id) {
+	velDecay(id, decay[id]);
+}
+void EntityStore::velDecay(int id, float rate) {
+
+	// Exponentially decrease speed when velocity is greater than 5 (smooth deceleration)
+	// Anything slower stops, unless it is being steered: at high rates a single step's steering can be under 5
+	if (velX[id] * velX[id] + velY[id] * velY[id] > 25 || steerX[id] != 0 || steerY[id] != 0) {
+		velX[id] -= velX[id] * rate;
+		velY[id] -= velY[id] * rate;
+	}
+	else {
+		velY[id] = velX[id] = 0;
+	}
+}
+void EntityStore::speedCheck(int id) {
+
+	float mag2 = velX[id] * velX[id] + velY[id] * velY[id];
+	if (mag2 > speedCap[id] * speedCap[id]) {
+		float r = 1 / std::sqrt(mag2);
+		velX[id] = velX[id] * r * speedCap[id];
+		velY[id] = velY[id] * r * speedCap[id];
+	}
+}
+void EntityStore::applySteer(int id) {
+	velX[id] += steerX[id];
+	velY[id] += steerY[id];
+	steerX[id] = steerY[id] = 0;
+}
+void EntityStore::bounce(int id) {
+	// If the entity collides with a boundary clamp it and invert the velocity
+	if (posX[id] < xLower[id] || posX[id] > xUpper[id]) {
+		posX[id] = posX[id] < xLower[id] ? xLower[id] : xUpper[id];
+		velX[id] = -velX[id];
+	}
+	if (posY[id] < yLower[id] || posY[id] > yUpper[id]) {
+		posY[id] = posY[id] < yLower[id] ? yLower[id] : yUpper[id];
+		velY[id] = -velY[id];
+	}
+}
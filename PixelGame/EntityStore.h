@@ -0,0 +1,145 @@
+#pragma once
+#include "../olcPixelGameEngine.h"
+#include <vector>
+
+// SSE2 is always there on x64, AVX2 is picked at runtime
+#if !defined(ENTITYSTORE_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define ENTITYSTORE_SIMD
+#endif
+
+// Structure of arrays holding the physics state of every entity
+// Entity objects only keep an id into these arrays, so a whole crowd of NPCs
+// can be integrated by walking a few contiguous float arrays instead of
+// chasing pointers around the heap.
+class EntityStore {
+
+public:
+
+	// Maximum x and y boundaries
+	// Upper bound describes the largest value
+	// Lower bound describes the smallest value
+	struct Boundary {
+		// Each boundary for how far the object can travel
+		// Note that lower and upper refer to the integer values (not acutal position, this is inverted)
+		float xLower;
+		float xUpper;
+		float yLower;
+		float yUpper;
+	};
+
+public:
+	// General physics variables
+	std::vector<float> posX, posY;
+	std::vector<float> prevX, prevY;	// Positions before the last step (for drawing in between steps)
+	std::vector<float> velX, velY;
+	std::vector<float> mass;
+
+	// Velocity applied after decay and speed capping on the next step (NPC steering)
+	std::vector<float> steerX, steerY;
+
+	// Specific behavior (limiters)
+	std::vector<float> speedCap;
+	std::vector<float> speed;
+	std::vector<float> dampen;	// Fraction of velocity lost per step at referenceStep (use setDampen)
+	std::vector<float> decay;	// Same for the current step, what integrate() actually uses
+	std::vector<float> slowDecay;	// Same for a slow step (slowSteps steps at once)
+
+	// General boundaries
+	std::vector<float> xLower, xUpper;
+	std::vector<float> yLower, yUpper;
+
+	// 1 if the slot should be stepped by integrate() this frame
+	std::vector<uint8_t> simulate;
+
+	// 1 if the slot should take a slow step this frame (see integrateSlow())
+	std::vector<uint8_t> slow;
+
+	// Step the movement constants are tuned for
+	static constexpr float referenceStep = 1.0f / 60.0f;
+
+	// Which integrate() implementation to use
+	// AUTO picks the widest one the cpu supports, the others force a path (comparisons and profiling)
+	enum Kernel {
+		AUTO,
+		SCALAR,
+		SSE,
+		AVX2
+	};
+	Kernel kernel = AUTO;
+
+private:
+	// 1 if the slot is owned by an entity
+	std::vector<uint8_t> alive;
+
+	// Released slots that can be handed out again
+	std::vector<int> freeSlots;
+
+	// Step integrate() is called with
+	float step = referenceStep;
+
+	// Steps a slow step covers
+	int slowSteps = 1;
+
+public:
+
+	// Reserve a slot and return its id
+	int create(olc::vf2d pos, olc::vf2d vel, float m);
+
+	// Hand a slot back (the id must not be used afterwards)
+	void release(int id);
+
+	// Number of slots (including released ones)
+	int size();
+
+	// Clears every simulate and slow flag
+	void clearSimulate();
+
+	Boundary getBoundary(int id);
+	void setBoundary(int id, Boundary b);
+
+	// Velocity damping is per step, so it has to be rescaled when the step changes
+	void setStep(float elapsedTime);
+	void setDampen(int id, float d);
+
+	// Length of a step, and compared to referenceStep (impulses tuned per reference step are scaled by it)
+	float getStep();
+	float stepRatio();
+
+	// Fraction per step that adds up to 'fraction' per reference step (damping, catching up)
+	float perStep(float fraction);
+
+	// Number of steps integrateSlow() covers at once
+	void setSlowSteps(int steps);
+
+	// Remember every position before a step, interpolate() blends from there
+	void savePositions();
+	olc::vf2d interpolate(int id, float alpha);
+
+	// Steps every slot flagged in 'simulate' in one pass:
+	// velocity decay, speed cap, steering, position and boundary bounce
+	void integrate(float elapsedTime);
+
+	// Same as integrate() for the slots in [first, last)
+	// Slots don't affect each other, so ranges that don't overlap can be stepped on different threads
+	void integrate(float elapsedTime, int first, int last);
+
+	// Same as integrate() for a single slot
+	void integrate(int id, float elapsedTime);
+
+	// Steps every slot flagged in 'slow' in [first, last) by slowSteps steps at once (elapsedTime is the whole slow step)
+	// Cheaper stand in for stepping them one at a time, used for entities nobody is looking at
+	void integrateSlow(float elapsedTime, int first, int last);
+
+	// Individual stages (used by entities that override part of the behavior)
+	void velDecay(int id);
+	void speedCheck(int id);
+	void applySteer(int id);
+	void bounce(int id);
+
+private:
+
+	// Steps the slots in [first, last) flagged in 'flags' with the given damping
+	void integrate(const std::vector<uint8_t>& flags, const std::vector<float>& rates, float elapsedTime, int first, int last);
+	void integrate(int id, float elapsedTime, float rate);
+	void velDecay(int id, float rate);
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+// Runs the simulation at a constant rate no matter how often frames are drawn
+// Frame time is accumulated and spent in whole steps, whatever is left over says how far
+// the frame is between the last two steps (see alpha()) so positions can be interpolated.
+// Frames that take too long only run maxSteps steps and the rest of the time is dropped,
+// the game slows down instead of spending even longer on the next frame.
+class FixedStep {
+
+private:
+
+	float step;
+	int maxSteps;
+	float accumulator = 0;
+
+public:
+
+	FixedStep(float hz = 60.0f, int maxSteps = 5) {
+		setRate(hz);
+		setMaxSteps(maxSteps);
+	}
+
+	// Steps per second
+	void setRate(float hz) {
+		step = 1.0f / std::max(hz, 1.0f);
+		accumulator = 0;
+	}
+
+	// Most steps a single frame can run
+	void setMaxSteps(int steps) {
+		maxSteps = std::max(steps, 1);
+	}
+
+	// Length of a step (seconds)
+	float getStep() { return step; }
+
+	// Adds the frame's time and returns how many steps to run
+	int advance(float elapsedTime) {
+		accumulator += elapsedTime;
+
+		int steps = 0;
+		while (accumulator >= step && steps < maxSteps) {
+			accumulator -= step;
+			steps++;
+		}
+
+		// Too far behind to catch up
+		if (accumulator >= step) accumulator = std::fmod(accumulator, step);
+
+		return steps;
+	}
+
+	// How far the frame is from the last step to the next one [0, 1)
+	float alpha() {
+		return accumulator / step;
+	}
+};
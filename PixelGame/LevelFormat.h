@@ -0,0 +1,600 @@
+#pragma once
+#include "../olcPixelGameEngine.h"
+#include "json.hpp"
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Everything a level is made of, before any of its images are decoded
+struct LevelData {
+
+	// Where an entity starts and which skin it uses
+	struct Spawn {
+		olc::vf2d pos;
+		int skin = 0;		// Index into skins
+	};
+
+	int number = 0;
+
+	// Everything random in the level derives from this (per entity streams)
+	uint64_t seed = 0;
+
+	// 0 uses the game's default tile size
+	int tileSize = 0;
+
+	// Map size in tiles, 0 when the map image decides
+	olc::vi2d tiles = { 0, 0 };
+
+	// Map image (sliced into tiles) or tileset plus tile indices
+	std::string name;
+	std::string tileset;
+	std::vector<int> map;
+
+	Spawn player;
+	std::vector<Spawn> npcs;
+
+	// Every skin path the level uses, once
+	std::vector<std::string> skins;
+
+	// How a sprite sheet skin is cut into clips (one per row, frames left to right)
+	struct Animation {
+		int skin = 0;					// Index into skins
+		olc::vi2d frame = { 0, 0 };		// Frame size, 0 uses the tile size
+		float fps = 0.0f;				// 0 uses the default rate
+		std::vector<int> clips;			// Frames per clip, empty counts them in the sheet
+
+		// Fastest rate a level can ask for
+		static constexpr float maxFps = 1000.0f;
+	};
+
+	// Every skin that is a sprite sheet (entities that are "animated")
+	std::vector<Animation> animations;
+
+	// Seed of levels that don't have one, they still play out the same way each time
+	static uint64_t defaultSeed(int number) {
+		return 0x9E3779B97F4A7C15ULL * uint64_t(number + 1);
+	}
+};
+
+// Compiled levels
+// LevelCompiler turns leveldata.json into one file per level, the loader reads them straight
+// out of the pack without building a json document or looking up fields by name.
+// Layout (little endian, like the packs):
+//   Header
+//   Record npcs[npcCount]
+//   int32_t map[mapCount]
+//   AnimationRecord animations[animationCount]
+//   int32_t clips[clipCount]			(every animation's clips, one after the other)
+//   uint32_t stringEnds[stringCount]	(end of every string in the string data)
+//   char strings[stringBytes]			(skins first, then the map's name and tileset)
+class LevelFormat {
+
+public:
+
+	static constexpr uint32_t version = 2;
+	static constexpr uint32_t none = 0xFFFFFFFF;
+
+	struct Record {
+		float x, y;
+		uint32_t skin;
+	};
+
+	struct AnimationRecord {
+		uint32_t skin;
+		int32_t frameX, frameY;
+		float fps;
+		uint32_t clipCount;
+	};
+
+	struct Header {
+		char magic[4];			// "PGLV"
+		uint32_t version;
+		int32_t number;
+		int32_t tileSize;
+		uint64_t seed;
+		int32_t tilesX, tilesY;
+		uint32_t name;			// String ids, none if there isn't one
+		uint32_t tileset;
+		uint32_t skinCount;
+		uint32_t stringCount;
+		uint32_t stringBytes;
+		uint32_t npcCount;
+		uint32_t mapCount;
+		uint32_t animationCount;
+		uint32_t clipCount;
+		Record player;
+	};
+
+	static_assert(sizeof(Record) == 12 && sizeof(AnimationRecord) == 20 && sizeof(Header) == 80 && sizeof(int) == 4, "Level structures must not be padded");
+
+	// Where a compiled level lives (in the pack and next to leveldata.json)
+	static std::string path(int number) {
+		return "./Assets/data/level" + std::to_string(number) + ".bin";
+	}
+
+	// Reads one level out of leveldata.json without building a json document
+	// Levels before it are only scanned and parsing stops as soon as it is complete
+	// Throws if the level is missing or broken
+	static LevelData fromJson(const char* data, size_t size, int number) {
+		JsonLevels reader(number);
+		nlohmann::json::sax_parse(data, data + size, &reader);
+		if (reader.levels.empty()) throw std::runtime_error("There is no level " + std::to_string(number));
+		return std::move(reader.levels.front());
+	}
+
+	// Every level in leveldata.json, in the order they are in the file
+	static std::vector<LevelData> fromJson(const char* data, size_t size) {
+		JsonLevels reader(-1);
+		nlohmann::json::sax_parse(data, data + size, &reader);
+		return std::move(reader.levels);
+	}
+
+	static void write(const LevelData& level, std::ostream& os) {
+
+		// Skins first so their string ids are their indices
+		std::vector<std::string> strings = level.skins;
+		auto add = [&](const std::string& s) {
+			if (s.empty()) return none;
+			strings.push_back(s);
+			return uint32_t(strings.size() - 1);
+		};
+
+		Header h;
+		memcpy(h.magic, "PGLV", 4);
+		h.version = version;
+		h.number = level.number;
+		h.tileSize = level.tileSize;
+		h.seed = level.seed;
+		h.tilesX = level.tiles.x;
+		h.tilesY = level.tiles.y;
+		h.name = add(level.name);
+		h.tileset = add(level.tileset);
+		h.skinCount = uint32_t(level.skins.size());
+		h.stringCount = uint32_t(strings.size());
+		h.npcCount = uint32_t(level.npcs.size());
+		h.mapCount = uint32_t(level.map.size());
+		h.player = record(level.player);
+
+		std::vector<AnimationRecord> animations;
+		std::vector<int32_t> clips;
+		for (const LevelData::Animation& a : level.animations) {
+			animations.push_back({ uint32_t(a.skin), a.frame.x, a.frame.y, a.fps, uint32_t(a.clips.size()) });
+			clips.insert(clips.end(), a.clips.begin(), a.clips.end());
+		}
+		h.animationCount = uint32_t(animations.size());
+		h.clipCount = uint32_t(clips.size());
+
+		std::vector<uint32_t> ends;
+		std::string data;
+		for (const std::string& s : strings) {
+			data += s;
+			ends.push_back(uint32_t(data.size()));
+		}
+		h.stringBytes = uint32_t(data.size());
+
+		std::vector<Record> npcs;
+		for (const LevelData::Spawn& s : level.npcs) npcs.push_back(record(s));
+		std::vector<int32_t> map(level.map.begin(), level.map.end());
+
+		os.write((const char*)&h, sizeof(h));
+		os.write((const char*)npcs.data(), npcs.size() * sizeof(Record));
+		os.write((const char*)map.data(), map.size() * sizeof(int32_t));
+		os.write((const char*)animations.data(), animations.size() * sizeof(AnimationRecord));
+		os.write((const char*)clips.data(), clips.size() * sizeof(int32_t));
+		os.write((const char*)ends.data(), ends.size() * sizeof(uint32_t));
+		os.write(data.data(), data.size());
+	}
+
+	// Throws if the data isn't a compiled level of this version or doesn't add up
+	static LevelData read(const char* data, size_t size) {
+
+		Header h;
+		if (size < sizeof(h)) throw std::runtime_error("Compiled level is truncated");
+		memcpy(&h, data, sizeof(h));
+		if (memcmp(h.magic, "PGLV", 4) != 0) throw std::runtime_error("Not a compiled level");
+		if (h.version != version) throw std::runtime_error("Compiled level is version " + std::to_string(h.version) + ", recompile it");
+
+		// Sections follow the header back to back
+		uint64_t npcs = sizeof(h);
+		uint64_t map = npcs + uint64_t(h.npcCount) * sizeof(Record);
+		uint64_t animations = map + uint64_t(h.mapCount) * sizeof(int32_t);
+		uint64_t clips = animations + uint64_t(h.animationCount) * sizeof(AnimationRecord);
+		uint64_t ends = clips + uint64_t(h.clipCount) * sizeof(int32_t);
+		uint64_t strings = ends + uint64_t(h.stringCount) * sizeof(uint32_t);
+		if (strings + h.stringBytes != size || h.skinCount > h.stringCount)
+			throw std::runtime_error("Compiled level is broken");
+
+		std::vector<uint32_t> stringEnds(h.stringCount);
+		if (h.stringCount > 0) memcpy(stringEnds.data(), data + ends, stringEnds.size() * sizeof(uint32_t));
+		auto text = [&](uint32_t id) {
+			if (id == none) return std::string();
+			if (id >= h.stringCount) throw std::runtime_error("Compiled level is broken");
+			uint32_t begin = id > 0 ? stringEnds[id - 1] : 0;
+			if (begin > stringEnds[id] || stringEnds[id] > h.stringBytes) throw std::runtime_error("Compiled level is broken");
+			return std::string(data + strings + begin, stringEnds[id] - begin);
+		};
+
+		LevelData level;
+		level.number = h.number;
+		level.seed = h.seed;
+		level.tileSize = h.tileSize;
+		level.tiles = { h.tilesX, h.tilesY };
+		level.name = text(h.name);
+		level.tileset = text(h.tileset);
+
+		// The map is allocated from the dimensions, a tileset's indices have to fill it exactly
+		if (h.tilesX < 0 || h.tilesY < 0) throw std::runtime_error("Compiled level is broken");
+		if (!level.tileset.empty() && uint64_t(h.tilesX) * uint64_t(h.tilesY) != h.mapCount) throw std::runtime_error("Compiled level is broken");
+
+		for (uint32_t i = 0; i < h.skinCount; i++) level.skins.push_back(text(i));
+
+		auto spawn = [&](const Record& r) {
+			if (r.skin >= h.skinCount) throw std::runtime_error("Compiled level is broken");
+			LevelData::Spawn s;
+			s.pos = { r.x, r.y };
+			s.skin = int(r.skin);
+			return s;
+		};
+		level.player = spawn(h.player);
+
+		level.npcs.resize(h.npcCount);
+		for (uint32_t i = 0; i < h.npcCount; i++) {
+			Record r;
+			memcpy(&r, data + npcs + i * sizeof(Record), sizeof(r));
+			level.npcs[i] = spawn(r);
+		}
+
+		level.map.resize(h.mapCount);
+		if (h.mapCount > 0) memcpy(level.map.data(), data + map, level.map.size() * sizeof(int32_t));
+
+		uint64_t clip = 0;
+		for (uint32_t i = 0; i < h.animationCount; i++) {
+			AnimationRecord r;
+			memcpy(&r, data + animations + i * sizeof(AnimationRecord), sizeof(r));
+			if (r.skin >= h.skinCount || r.clipCount > h.clipCount - clip || !(r.fps >= 0 && r.fps <= LevelData::Animation::maxFps))
+				throw std::runtime_error("Compiled level is broken");
+
+			LevelData::Animation a;
+			a.skin = int(r.skin);
+			a.frame = { r.frameX, r.frameY };
+			a.fps = r.fps;
+			a.clips.resize(r.clipCount);
+			if (r.clipCount > 0) memcpy(a.clips.data(), data + clips + clip * sizeof(int32_t), a.clips.size() * sizeof(int32_t));
+			clip += r.clipCount;
+			level.animations.push_back(std::move(a));
+		}
+		if (clip != h.clipCount) throw std::runtime_error("Compiled level is broken");
+
+		return level;
+	}
+
+private:
+
+	static Record record(const LevelData::Spawn& s) {
+		return { s.pos.x, s.pos.y, uint32_t(s.skin) };
+	}
+
+	// Builds levels straight from the parser's events
+	// { "<number>": { "seed", "tilesize", "tiles": [x, y], "name", "tileset", "map": [...],
+	//   "player": entity, "npcs": [entity, ...], "animations": { "<skin>": animation, ... } } }
+	// with entity = { "animated", "skin", "location": [x, y] }
+	// and animation = { "frame": [w, h], "fps", "clips": [frames, ...] } (all optional)
+	// Anything else (including every level that wasn't asked for) is skipped without being stored
+	class JsonLevels : public nlohmann::json_sax<nlohmann::json> {
+
+	public:
+
+		std::vector<LevelData> levels;
+
+		// Level to read, -1 for all of them
+		JsonLevels(int wanted) : wanted(wanted) { }
+
+	private:
+
+		// What the parser is in
+		enum Context {
+			LEVELS,
+			LEVEL,
+			TILES,
+			MAP,
+			NPCS,
+			ENTITY,
+			LOCATION,
+			ANIMATIONS,
+			ANIMATION,
+			FRAME,
+			CLIPS
+		};
+
+		int wanted;
+		std::vector<Context> stack;
+		std::string lastKey;
+
+		// Depth inside a value that is being skipped
+		int skipping = 0;
+
+		// Level being read
+		LevelData* level = nullptr;
+		std::map<std::string, int> ids;
+
+		// Name of the sheet every skin was animated with (empty if it isn't a sheet)
+		std::vector<std::string> sheets;
+
+		// Clips by sheet name, only the ones an animated entity uses are kept
+		std::map<std::string, LevelData::Animation> clips;
+		LevelData::Animation* animation = nullptr;
+		bool hasPlayer = false, hasNpcs = false, hasMap = false, hasTileset = false;
+		int element = 0;
+
+		// Entity being read
+		bool isPlayer = false;
+		int animated = -1;
+		std::string skin;
+		bool hasSkin = false;
+		olc::vf2d location;
+		int locations = 0;
+
+		[[noreturn]] void fail(const std::string& what) {
+			throw std::runtime_error("Level " + std::to_string(level ? level->number : wanted) + ": " + what);
+		}
+
+		// Scalars, everything ends up here
+		bool number(double v) {
+			if (skipping || stack.empty()) return true;
+			switch (stack.back()) {
+			case LEVEL:
+				if (lastKey == "tilesize") level->tileSize = int(v);
+				break;
+			case TILES:
+				if (v < 0) fail("\"tiles\" can't be negative");
+				if (element < 2) (element == 0 ? level->tiles.x : level->tiles.y) = int(v);
+				element++;
+				break;
+			case MAP:
+				level->map.push_back(int(v));
+				break;
+			case LOCATION:
+				if (locations < 2) (locations == 0 ? location.x : location.y) = float(v);
+				locations++;
+				break;
+			case ANIMATION:
+				if (lastKey == "fps") {
+					if (!(v >= 0 && v <= LevelData::Animation::maxFps)) fail("animations need an \"fps\" between 0 and 1000");
+					animation->fps = float(v);
+				}
+				break;
+			case FRAME:
+				if (v < 0) fail("animation frames can't be negative");
+				if (element < 2) (element == 0 ? animation->frame.x : animation->frame.y) = int(v);
+				element++;
+				break;
+			case CLIPS:
+				if (v < 0) fail("animation clips can't be negative");
+				animation->clips.push_back(int(v));
+				break;
+			default:
+				break;
+			}
+			return true;
+		}
+
+		bool text(const std::string& v) {
+			if (skipping || stack.empty()) return true;
+			if (stack.back() == LEVEL && lastKey == "name") level->name = v;
+			if (stack.back() == LEVEL && lastKey == "tileset") {
+				level->tileset = v;
+				hasTileset = true;
+			}
+			if (stack.back() == ENTITY && lastKey == "skin") {
+				skin = v;
+				hasSkin = true;
+			}
+			return true;
+		}
+
+		// Starts skipping or enters the context
+		bool enter(Context c) {
+			stack.push_back(c);
+			return true;
+		}
+		bool skip() {
+			skipping++;
+			return true;
+		}
+
+		void beginLevel(int number) {
+			levels.emplace_back();
+			level = &levels.back();
+			level->number = number;
+			level->seed = LevelData::defaultSeed(number);
+			ids.clear();
+			sheets.clear();
+			clips.clear();
+			hasPlayer = hasNpcs = hasMap = hasTileset = false;
+		}
+
+		void beginEntity(bool player) {
+			isPlayer = player;
+			animated = -1;
+			hasSkin = false;
+			locations = 0;
+		}
+
+		void endEntity() {
+			if (animated < 0 || !hasSkin || locations < 2) fail("entities need \"animated\", \"skin\" and \"location\"");
+
+			// Determine if the decal is going to be animated
+			std::string path = animated ? "./Assets/images/sprite_sheets/" : "./Assets/images/sprites/";
+			path += skin + ".png";
+
+			// Skins are interned as they come up
+			auto it = ids.find(path);
+			if (it == ids.end()) {
+				it = ids.emplace(path, int(level->skins.size())).first;
+				level->skins.push_back(path);
+				sheets.push_back(animated ? skin : std::string());
+			}
+
+			LevelData::Spawn s;
+			s.pos = location;
+			s.skin = it->second;
+			if (isPlayer) {
+				level->player = s;
+				hasPlayer = true;
+			}
+			else {
+				level->npcs.push_back(s);
+			}
+		}
+
+		// Returns false once the wanted level is complete, which stops the parser
+		bool endLevel() {
+			if (!hasPlayer || !hasNpcs) fail("\"player\" and \"npcs\" are required");
+			// The tile indices only mean something together with their tileset
+			if (!hasMap || !hasTileset) {
+				level->tileset.clear();
+				level->map.clear();
+			}
+			if (!level->tileset.empty() && uint64_t(level->tiles.x) * uint64_t(level->tiles.y) != level->map.size())
+				fail("\"map\" needs one index for each of the \"tiles\"");
+
+			// Player's skin first, then the NPCs' in order, whatever order the keys were in
+			std::vector<int> remap(level->skins.size(), -1);
+			std::vector<std::string> ordered;
+			std::vector<std::string> orderedSheets;
+			auto use = [&](LevelData::Spawn& s) {
+				if (remap[s.skin] < 0) {
+					remap[s.skin] = int(ordered.size());
+					ordered.push_back(std::move(level->skins[s.skin]));
+					orderedSheets.push_back(std::move(sheets[s.skin]));
+				}
+				s.skin = remap[s.skin];
+			};
+			use(level->player);
+			for (LevelData::Spawn& s : level->npcs) use(s);
+			level->skins = std::move(ordered);
+
+			// Every sheet gets its clips (or has them counted by the loader)
+			for (int i = 0; i < int(orderedSheets.size()); i++) {
+				if (orderedSheets[i].empty()) continue;
+				auto it = clips.find(orderedSheets[i]);
+				LevelData::Animation a = it != clips.end() ? it->second : LevelData::Animation();
+				a.skin = i;
+				level->animations.push_back(std::move(a));
+			}
+
+			level = nullptr;
+			return wanted < 0;
+		}
+
+	public:
+
+		bool null() override { return true; }
+		bool boolean(bool v) override {
+			if (!skipping && !stack.empty() && stack.back() == ENTITY && lastKey == "animated") animated = v;
+			return true;
+		}
+		bool number_integer(number_integer_t v) override {
+			if (!skipping && !stack.empty() && stack.back() == LEVEL && lastKey == "seed") level->seed = uint64_t(v);
+			return number(double(v));
+		}
+		bool number_unsigned(number_unsigned_t v) override {
+			if (!skipping && !stack.empty() && stack.back() == LEVEL && lastKey == "seed") level->seed = v;
+			return number(double(v));
+		}
+		bool number_float(number_float_t v, const string_t&) override { return number(v); }
+		bool string(string_t& v) override { return text(v); }
+		bool binary(binary_t&) override { return true; }
+
+		bool key(string_t& k) override {
+			if (!skipping) lastKey = k;
+			return true;
+		}
+
+		bool start_object(std::size_t) override {
+			if (skipping) return skip();
+			if (stack.empty()) return enter(LEVELS);
+
+			switch (stack.back()) {
+			case LEVELS:
+				// Level numbers are the keys
+				if (wanted >= 0 && lastKey != std::to_string(wanted)) return skip();
+				beginLevel(wanted >= 0 ? wanted : std::stoi(lastKey));
+				return enter(LEVEL);
+			case LEVEL:
+				if (lastKey == "animations") return enter(ANIMATIONS);
+				if (lastKey != "player") return skip();
+				beginEntity(true);
+				return enter(ENTITY);
+			case NPCS:
+				beginEntity(false);
+				return enter(ENTITY);
+			case ANIMATIONS:
+				// Sheet names are the keys
+				animation = &clips[lastKey];
+				*animation = LevelData::Animation();
+				return enter(ANIMATION);
+			default:
+				return skip();
+			}
+		}
+
+		bool end_object() override {
+			if (skipping) {
+				skipping--;
+				return true;
+			}
+
+			Context c = stack.back();
+			stack.pop_back();
+			if (c == ENTITY) endEntity();
+			if (c == LEVEL) return endLevel();
+			return true;
+		}
+
+		bool start_array(std::size_t) override {
+			if (skipping || stack.empty()) return skip();
+
+			if (stack.back() == LEVEL) {
+				element = 0;
+				if (lastKey == "tiles") return enter(TILES);
+				if (lastKey == "map") {
+					level->map.clear();
+					hasMap = true;
+					return enter(MAP);
+				}
+				if (lastKey == "npcs") {
+					hasNpcs = true;
+					return enter(NPCS);
+				}
+			}
+			if (stack.back() == ENTITY && lastKey == "location") return enter(LOCATION);
+			if (stack.back() == ANIMATION) {
+				element = 0;
+				if (lastKey == "frame") return enter(FRAME);
+				if (lastKey == "clips") {
+					animation->clips.clear();
+					return enter(CLIPS);
+				}
+			}
+			return skip();
+		}
+
+		bool end_array() override {
+			if (skipping) {
+				skipping--;
+				return true;
+			}
+			stack.pop_back();
+			return true;
+		}
+
+		bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) override {
+			throw std::runtime_error(e.what());
+		}
+	};
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include "../olcPixelGameEngine.h"
+#include "Tilemap.h"
+#include "Animation.h"
+#include "LevelFormat.h"
+#include "SpriteAtlas.h"
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Decodes levels away from the engine thread
+// Reading the pack, parsing the level data, decoding the images and slicing the map all happen
+// in decode(), which request() runs on a worker thread while the current level keeps going.
+// The engine thread only has to create the entities and upload the textures once it's ready.
+class LevelLoader {
+
+public:
+
+	// Where an entity starts and which skin (index into Level::skins) it uses
+	typedef LevelData::Spawn Spawn;
+
+	// A skin decoded on the loader thread (no sprite when it is in the atlas)
+	struct Skin {
+		std::string path;
+		std::unique_ptr<olc::Sprite> sprite;
+
+		// Clips if the skin is a sprite sheet
+		std::shared_ptr<const AnimationSheet> sheet;
+	};
+
+	// A decoded level waiting to be swapped in
+	struct Level {
+		int number = 0;
+
+		// Everything random in the level derives from this (per entity streams)
+		uint64_t seed = 0;
+
+		// Built but not uploaded yet
+		Tilemap tilemap;
+
+		Spawn player;
+		std::vector<Spawn> npcs;
+
+		// Every skin the level uses, decoded once per path
+		std::vector<Skin> skins;
+
+		// Pages of the pack's atlas, empty if it doesn't have one
+		SpriteAtlas atlas;
+	};
+
+private:
+
+	std::future<std::unique_ptr<Level>> pending;
+
+public:
+
+	// Does all the cpu work for a level, safe to call from any thread
+	// Throws if the pack can't be opened or the level data is broken
+	static std::unique_ptr<Level> decode(int number, std::string key, int defaultTileSize) {
+
+		// Each load gets its own pack so nothing is shared with the engine thread
+		olc::ResourcePack pack;
+		if (!pack.LoadPack("./Assets/data/" + std::to_string(number) + ".dat", key, true))
+			throw std::runtime_error("Unable to open the resource pack for level " + std::to_string(number));
+
+		// Compiled levels (see LevelCompiler) are read as they are, older packs only have the json
+		LevelData data;
+		olc::ResourceBuffer compiled = pack.GetFileBuffer(LevelFormat::path(number));
+		if (compiled.Size() > 0) {
+			data = LevelFormat::read(compiled.Data(), compiled.Size());
+		}
+		else {
+			olc::ResourceBuffer rb = pack.GetFileBuffer("./Assets/data/leveldata.json");
+			data = LevelFormat::fromJson(rb.Data(), rb.Size(), number);
+		}
+
+		std::unique_ptr<Level> level = std::make_unique<Level>();
+		level->number = number;
+		level->seed = data.seed;
+
+		// Load the map tiles
+		int tileSize = data.tileSize > 0 ? data.tileSize : defaultTileSize;
+		if (!data.tileset.empty()) {
+
+			// Tile indices are in the level data
+			olc::Sprite tileset("./Assets/images/sprites/" + data.tileset + ".png", &pack);
+			level->tilemap.load(&tileset, tileSize, data.tiles, data.map);
+		}
+		else {
+
+			// Slice the full map image, only the unique tiles are kept once it is gone
+			olc::Sprite mapSprite("./Assets/images/sprites/" + data.name + ".png", &pack);
+			olc::vi2d tiles = { mapSprite.width / tileSize, mapSprite.height / tileSize };
+			if (data.tiles.x > 0 && data.tiles.y > 0) tiles = data.tiles;
+			level->tilemap.build(&mapSprite, tileSize, tiles);
+		}
+
+		// Player and NPC spawns
+		level->player = data.player;
+		level->npcs = std::move(data.npcs);
+
+		// Skins packed into the atlas (see LevelCompiler) come with its pages, the rest are decoded once each
+		olc::ResourceBuffer atlas = pack.GetFileBuffer(SpriteAtlas::path());
+		if (atlas.Size() > 0) level->atlas = SpriteAtlas::read(atlas.Data(), atlas.Size());
+		for (const std::string& path : data.skins) {
+			if (level->atlas.find(path)) level->skins.push_back({ path, nullptr });
+			else level->skins.push_back({ path, std::make_unique<olc::Sprite>(path, &pack) });
+		}
+
+		// Sprite sheets are cut into clips, the frames are counted in the sheet when the level data doesn't list them
+		for (const LevelData::Animation& a : data.animations) {
+			Skin& skin = level->skins[a.skin];
+			olc::vi2d frame = a.frame.x > 0 && a.frame.y > 0 ? a.frame : olc::vi2d(tileSize, tileSize);
+
+			// The sheet is either on an atlas page or a sprite of its own
+			olc::Sprite* sprite = skin.sprite.get();
+			olc::vi2d pos = { 0, 0 };
+			olc::vi2d size = { 0, 0 };
+			if (const SpriteAtlas::Region* region = level->atlas.find(skin.path)) {
+				sprite = level->atlas.getPage(region->page);
+				pos = region->pos;
+				size = region->size;
+			}
+			else {
+				size = { sprite->width, sprite->height };
+			}
+
+			std::vector<int> clips = a.clips.empty() ? AnimationSheet::countFrames(sprite, pos, size, frame) : a.clips;
+			bool fits = int64_t(clips.size()) * frame.y <= size.y;
+			for (int count : clips) fits &= int64_t(count) * frame.x <= size.x;
+			if (!fits) throw std::runtime_error("The clips of " + skin.path + " don't fit in the sheet");
+
+			skin.sheet = std::make_shared<const AnimationSheet>(frame, a.fps, clips);
+		}
+
+		return level;
+	}
+
+	// Start decoding a level in the background
+	// A level that is still being decoded is waited on and thrown away
+	void request(int number, const std::string& key, int defaultTileSize) {
+		pending = std::async(std::launch::async, decode, number, key, defaultTileSize);
+	}
+
+	// Is a level being decoded (or waiting to be taken)?
+	bool loading() {
+		return pending.valid();
+	}
+
+	// Is the requested level ready to be taken without blocking?
+	bool ready() {
+		return pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	// Hand over the decoded level (blocks if it isn't ready yet)
+	// Anything decode() threw is rethrown here
+	std::unique_ptr<Level> take() {
+		return pending.get();
+	}
+};
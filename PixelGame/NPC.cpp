@@ -23,44 +23,43 @@ NPC::NPC(olc::vf2d pos, int32_t width, int32_t height, float mass)
 // Virtual functions
 void NPC::updatePosition(float elapsedTime) {
 
-	// Various checks and adjustments to velocity
-	this->velDecay();
-	this->speedCheck();
-
 	// Randomly decide if the NPC should move
+	// (steering is applied after velocity decay and speed checks)
 	this->randMove();
 
-	// Update position
-	this->increasePos(this->getVel() * elapsedTime);
-
-	this->collision();			// Check collision
+	// Update position and check collision
+	Entity::updatePosition(elapsedTime);
 
 }
 
-// Private functions
-void NPC::randMove() {
+// Public functions
+void NPC::randMove(int steps) {
+
+	// Time this call covers, compared to a 60Hz step
+	float step = store.getStep() * steps;
+	float ratio = store.stepRatio() * steps;
 
 	// Should the NPC decide to move?
-	// 1/alpha chance per frame to decide to move
-	if (rand() % alpha == 0) {
+	// 1/alpha chance per 60Hz step to decide to move (rolled once for the whole step)
+	if (rng.chance(uint32_t(std::max(1.0f, std::round(alpha / ratio))))) {
 
 		// Choose axis parameters
-		positiveX = rand() % 2 == 0;
-		positiveY = rand() % 2 == 0;
-		int direction = rand() % 3;
+		positiveX = rng.below(2) == 0;
+		positiveY = rng.below(2) == 0;
+		int direction = rng.below(3);
 
 		// Based on directional decisions
 		switch (direction)
 		{
 		case 0:		// x-axis
-			moveTimerX += rand() % maxDist;
+			moveTimerX += rng.below(maxDist) * EntityStore::referenceStep;
 			break;
 
 		case 1:		// x-axis and y-axis (case 1 and 2)
-			moveTimerX += rand() % maxDist;
+			moveTimerX += rng.below(maxDist) * EntityStore::referenceStep;
 
 		case 2:		// y-axis only
-			moveTimerY += rand() % maxDist;
+			moveTimerY += rng.below(maxDist) * EntityStore::referenceStep;
 			break;
 
 			// This should never actually happen
@@ -70,16 +69,37 @@ void NPC::randMove() {
 	}
 
 	// As long as the move timer is positive for the axis...
+	// (speed is the steering per 60Hz step, so it is scaled by the part of the step the timer covers)
 	if (moveTimerX > 0) {
 
-
-
 		// Adjust velocity
-		moveTimerX--;
-		positiveX ? this->increaseVel({ this->getSpeed(), 0.0f }) : this->increaseVel({ -this->getSpeed(), 0.0f });
+		float t = std::min(moveTimerX, step);
+		moveTimerX -= t;
+		float speed = this->getSpeed() * (t / EntityStore::referenceStep);
+		positiveX ? this->increaseSteer({ speed, 0.0f }) : this->increaseSteer({ -speed, 0.0f });
 	}
 	if (moveTimerY > 0) {
-		moveTimerY--;
-		positiveY ? this->increaseVel({ 0.0f, this->getSpeed() }) : this->increaseVel({ 0.0f, -this->getSpeed() });
+		float t = std::min(moveTimerY, step);
+		moveTimerY -= t;
+		float speed = this->getSpeed() * (t / EntityStore::referenceStep);
+		positiveY ? this->increaseSteer({ 0.0f, speed }) : this->increaseSteer({ 0.0f, -speed });
 	}
-}
\ No newline at end of file
+}
+
+void NPC::chooseAnimation() {
+
+	// Standing still, now and then play the idle clip
+	olc::vf2d vel = this->getVel();
+	if (vel.mag2() == 0) {
+		this->selectAnimation(IDLE);
+		this->idleAnimation(200);
+		return;
+	}
+
+	// Walk whichever way it is mostly heading
+	if (std::abs(vel.x) >= std::abs(vel.y))
+		this->selectAnimation(vel.x > 0 ? WALK_RIGHT : WALK_LEFT);
+	else
+		this->selectAnimation(vel.y > 0 ? WALK_DOWN : WALK_UP);
+	this->playAnimation();
+}
@@ -50,43 +50,43 @@ void Player::updatePosition(float elapsedTime) {
 	this->collision();			// Check collision with boundaries
 
 	// Animation
-	am->updateAnimation(elapsedTime);
+	this->animate(elapsedTime);
 	if (this->getVel().mag2() == 0) {
-		am->selectAnimation(0);
-		am->idle(200);
+		this->selectAnimation(IDLE);
+		this->idleAnimation(200);
 	}
 }
-//void Player::initAnimations(std::vector<int> animationCounts, int framesPerAnimation, std::string file){}
 
 // Public functions
 void Player::move(Move m) {
 
-	float speed = this->getSpeed();
+	// Speed is what a 60Hz step adds, longer steps add more of it
+	float speed = this->getSpeed() * store.stepRatio();
 
 	switch (m)
 	{
 	case Player::UP:
 		this->increaseVel({ 0.0f, -speed });
-		am->selectAnimation(3);
+		this->selectAnimation(WALK_UP);
 		break;
 	case Player::DOWN:
 		this->increaseVel({ 0.0f, speed });
-		am->selectAnimation(4);
+		this->selectAnimation(WALK_DOWN);
 		break;
 	case Player::LEFT:
 		this->increaseVel({ -speed, 0.0f });
-		am->selectAnimation(2);
+		this->selectAnimation(WALK_LEFT);
 		break;
 	case Player::RIGHT:
 		this->increaseVel({ speed, 0.0f });
-		am->selectAnimation(1);
+		this->selectAnimation(WALK_RIGHT);
 		break;
 	default:
 		break;
 	}
 
 	// Make sure that we play the animation we selected
-	am->play();
+	this->playAnimation();
 }
 
 // Private functions
@@ -95,7 +95,7 @@ void Player::cameraManip() {
 	olc::vf2d pos = this->getPos();
 
 	// Adjust the camera based on current position
-	cam->smooth(pos);
+	cam->smooth(pos, store.stepRatio());
 
 	Boundary b = this->getBoundary();
 
@@ -108,8 +108,9 @@ void Player::cameraManip() {
 	olc::vf2d dist = midPoint - pos;
 
 	// Determine how quickly to adjust the position based on distance from the midpoint
+	// (accel is per 60Hz step, so it is converted for the current step like damping)
 	if (dist.mag2() > stopRadius) {
-		this->increasePos(dist * accel);
+		this->increasePos(dist * store.perStep(accel));
 	}
 }
 void Player::collision() {
@@ -0,0 +1,257 @@
+#pragma once
+#include "../olcPixelGameEngine.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Per frame timings for the game loop
+// Game sections are measured with ScopedTimer, engine stages (deferred drawing, texture
+// upload, decal submission and presenting) are read back from the engine at the start of the next frame.
+// Frames can be drawn as a histogram and dumped to a csv file or a chrome://tracing file.
+class Profiler {
+
+public:
+
+	// Everything that gets timed
+	// New sections should be added before COUNT
+	enum Section {
+		INPUT,
+		PLAYER,
+		MAP,
+		COLLISION,
+		INTEGRATION,
+		DRAW,
+		RASTER,
+		DECALS,
+		UPLOAD,
+		DISPLAY,
+		COUNT
+	};
+
+	// Measures the time until it goes out of scope
+	class ScopedTimer {
+	public:
+		ScopedTimer(Profiler& p, Section s)
+			: profiler(p), section(s), start(clock::now())
+		{ }
+
+		~ScopedTimer() {
+			profiler.record(section, start, clock::now());
+		}
+
+	private:
+		Profiler& profiler;
+		Section section;
+		std::chrono::steady_clock::time_point start;
+	};
+
+private:
+
+	typedef std::chrono::steady_clock clock;
+
+	// One timed section within a frame (microseconds since the profiler was created)
+	struct Event {
+		Section section;
+		double start;
+		double duration;
+	};
+
+	struct Frame {
+		double start = 0;
+		float ms[COUNT] = { 0 };
+		std::vector<Event> events;
+	};
+
+	clock::time_point origin = clock::now();
+
+	// Frame being recorded and the one waiting on the engine's timings
+	Frame current;
+	Frame previous;
+	bool hasPrevious = false;
+	uint32_t frameNumber = 0;
+
+	// Rolling history for the histogram (ms per section)
+	static constexpr int historySize = 128;
+	float history[historySize][COUNT] = { { 0 } };
+	int historyHead = 0;
+
+	// Optional dumps
+	std::ofstream csv;
+	std::ofstream trace;
+	bool traceFirstEvent = true;
+
+public:
+
+	~Profiler() {
+		closeCSV();
+		closeTrace();
+	}
+
+	static const char* name(Section s) {
+		static const char* names[COUNT] = {
+			"input", "player", "map", "collision", "integration", "draw", "raster", "decals", "upload", "display"
+		};
+		return names[s];
+	}
+
+	static olc::Pixel colour(Section s) {
+		static const olc::Pixel colours[COUNT] = {
+			olc::GREY, olc::GREEN, olc::DARK_BLUE, olc::RED, olc::YELLOW, olc::CYAN, olc::DARK_CYAN, olc::MAGENTA, olc::DARK_GREEN, olc::WHITE
+		};
+		return colours[s];
+	}
+
+	// Start a new frame, the engine's timings belong to the frame before this one
+	void beginFrame(olc::PixelGameEngine* pge) {
+
+		if (hasPrevious) {
+			const olc::FrameTimings& t = pge->GetFrameTimings();
+
+			// Engine stages run after OnUserUpdate, in this order
+			double at = previous.events.empty() ? previous.start : previous.events.back().start + previous.events.back().duration;
+			addEngineStage(previous, RASTER, t.fRasterize, at);
+			addEngineStage(previous, UPLOAD, t.fTextureUpload, at);
+			addEngineStage(previous, DECALS, t.fDecalSubmit, at);
+			addEngineStage(previous, DISPLAY, t.fDisplayFrame, at);
+
+			finish(previous);
+		}
+
+		current.start = now();
+		current.events.clear();
+		for (float& ms : current.ms) ms = 0;
+	}
+
+	// Close the game side of the frame
+	void endFrame() {
+		std::swap(previous, current);
+		hasPrevious = true;
+	}
+
+	void record(Section s, clock::time_point begin, clock::time_point end) {
+		double start = std::chrono::duration<double, std::micro>(begin - origin).count();
+		double duration = std::chrono::duration<double, std::micro>(end - begin).count();
+		current.ms[s] += float(duration / 1000.0);
+		current.events.push_back({ s, start, duration });
+	}
+
+	// Average time spent in a section over the history (ms)
+	float average(Section s) {
+		float total = 0;
+		for (int i = 0; i < historySize; i++) total += history[i][s];
+		return total / historySize;
+	}
+
+	// Stacked bar per frame, newest on the right, with a 60Hz budget line
+	void draw(olc::PixelGameEngine* pge, olc::vi2d pos, int height = 64) {
+
+		const float budget = 1000.0f / 60.0f;
+		const float scale = height / (2 * budget);	// Two frames of budget fit in the graph
+
+		pge->FillRect(pos, { historySize, height }, olc::VERY_DARK_GREY);
+
+		for (int i = 0; i < historySize; i++) {
+			const float* frame = history[(historyHead + i) % historySize];
+			int y = pos.y + height;
+			for (int s = 0; s < COUNT; s++) {
+				int h = int(frame[s] * scale + 0.5f);
+				if (h <= 0) continue;
+				h = std::min(h, y - pos.y);
+				y -= h;
+				pge->DrawLine(pos.x + i, y, pos.x + i, y + h - 1, colour(Section(s)));
+			}
+		}
+
+		int budgetY = pos.y + height - int(budget * scale);
+		pge->DrawLine(pos.x, budgetY, pos.x + historySize - 1, budgetY, olc::DARK_RED, 0xF0F0F0F0);
+
+		// Legend
+		for (int s = 0; s < COUNT; s++) {
+			char text[32];
+			snprintf(text, sizeof(text), "%-11s %5.2f", name(Section(s)), average(Section(s)));
+			pge->DrawString(pos.x + historySize + 4, pos.y + s * 8, text, colour(Section(s)));
+		}
+
+		// What the renderer was asked to do
+		const olc::RenderStats& rs = pge->GetRenderStats();
+		char text[48];
+		snprintf(text, sizeof(text), "%u decals %u batches", rs.nDecals, rs.nBatches);
+		pge->DrawString(pos.x + historySize + 4, pos.y + COUNT * 8, text, olc::GREY);
+	}
+
+	// Per frame csv (one column per section in ms)
+	bool openCSV(const std::string& file) {
+		closeCSV();
+		csv.open(file);
+		if (!csv.is_open()) return false;
+
+		csv << "frame";
+		for (int s = 0; s < COUNT; s++) csv << "," << name(Section(s));
+		csv << ",total\n";
+		return true;
+	}
+	void closeCSV() {
+		if (csv.is_open()) csv.close();
+	}
+	bool recordingCSV() { return csv.is_open(); }
+
+	// Chrome trace event format (open in chrome://tracing or perfetto)
+	bool openTrace(const std::string& file) {
+		closeTrace();
+		trace.open(file);
+		if (!trace.is_open()) return false;
+
+		trace << "{\"traceEvents\":[\n";
+		traceFirstEvent = true;
+		return true;
+	}
+	void closeTrace() {
+		if (!trace.is_open()) return;
+		trace << "\n]}\n";
+		trace.close();
+	}
+	bool recordingTrace() { return trace.is_open(); }
+
+private:
+
+	double now() {
+		return std::chrono::duration<double, std::micro>(clock::now() - origin).count();
+	}
+
+	void addEngineStage(Frame& f, Section s, float seconds, double& at) {
+		double duration = seconds * 1000000.0;
+		f.ms[s] += seconds * 1000.0f;
+		f.events.push_back({ s, at, duration });
+		at += duration;
+	}
+
+	// Frame is complete, push it to the history and the dumps
+	void finish(Frame& f) {
+
+		float total = 0;
+		for (int s = 0; s < COUNT; s++) {
+			history[historyHead][s] = f.ms[s];
+			total += f.ms[s];
+		}
+		historyHead = (historyHead + 1) % historySize;
+
+		if (csv.is_open()) {
+			csv << frameNumber;
+			for (int s = 0; s < COUNT; s++) csv << "," << f.ms[s];
+			csv << "," << total << "\n";
+		}
+
+		if (trace.is_open()) {
+			for (Event& e : f.events) {
+				trace << (traceFirstEvent ? "" : ",\n");
+				trace << "{\"name\":\"" << name(e.section) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+					<< e.start << ",\"dur\":" << e.duration << ",\"args\":{\"frame\":" << frameNumber << "}}";
+				traceFirstEvent = false;
+			}
+		}
+
+		frameNumber++;
+	}
+};
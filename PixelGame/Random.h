@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+
+// Small, fast and seedable random numbers (PCG32)
+// Every entity owns one so its behaviour only depends on the level seed and its own
+// history, which keeps runs reproducible and lets entities be updated from any thread.
+// Generators with the same seed but a different stream produce unrelated sequences.
+class Random {
+
+private:
+
+	uint64_t state = 0;
+	uint64_t inc = 1;
+
+public:
+
+	Random(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0) {
+		this->seed(seed, stream);
+	}
+
+	void seed(uint64_t seed, uint64_t stream = 0) {
+		state = 0;
+		inc = (stream << 1) | 1;
+		next();
+		state += seed;
+		next();
+	}
+
+	// Uniform 32 bit value
+	uint32_t next() {
+		uint64_t old = state;
+		state = old * 6364136223846793005ULL + inc;
+		uint32_t xorshifted = uint32_t(((old >> 18) ^ old) >> 27);
+		uint32_t rot = uint32_t(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+	}
+
+	// Uniform value in [0, n) without the bias of next() % n
+	uint32_t below(uint32_t n) {
+		uint64_t m = uint64_t(next()) * n;
+		uint32_t low = uint32_t(m);
+		if (low < n) {
+			uint32_t threshold = (0u - n) % n;
+			while (low < threshold) {
+				m = uint64_t(next()) * n;
+				low = uint32_t(m);
+			}
+		}
+		return uint32_t(m >> 32);
+	}
+
+	// 1/n chance of being true
+	bool chance(uint32_t n) {
+		return below(n) == 0;
+	}
+
+	// Uniform value in [0, 1)
+	float unit() {
+		return (next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// New generator seeded from this one (e.g. for something the entity owns)
+	Random split() {
+		// One draw per statement, the order of operands within an expression isn't fixed
+		uint32_t a = next();
+		uint32_t b = next();
+		uint32_t c = next();
+		uint32_t d = next();
+		return Random((uint64_t(a) << 32) | b, (uint64_t(c) << 32) | d);
+	}
+};
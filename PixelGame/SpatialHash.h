@@ -0,0 +1,132 @@
+#pragma once
+#include "../olcPixelGameEngine.h"
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid broadphase
+// Entities are bucketed by the cell their position falls in. As long as the cell size
+// is at least the collision diameter, anything an entity can touch lives in one of
+// the 3x3 cells surrounding it.
+class SpatialHash {
+
+public:
+
+	SpatialHash(float cellSize)
+		: cellSize(cellSize), invCellSize(1.0f / cellSize)
+	{ }
+
+private:
+
+	float cellSize;
+	float invCellSize;
+
+	// Cell key -> ids of every entity currently inside that cell
+	std::unordered_map<int64_t, std::vector<int>> cells;
+
+	// Id -> key of the cell the entity was last placed in
+	std::vector<int64_t> cellOf;
+
+	// Marks ids that are not in the grid
+	static constexpr int64_t empty = INT64_MIN;
+
+public:
+
+	// Remove everything from the grid
+	void clear() {
+		cells.clear();
+		cellOf.clear();
+	}
+
+	// Add an entity to the grid (ids are expected to be small and dense, ie. vector indices)
+	void insert(int id, olc::vf2d pos) {
+		if (id >= (int)cellOf.size()) cellOf.resize(id + 1, empty);
+		int64_t key = keyOf(pos);
+		cellOf[id] = key;
+		cells[key].push_back(id);
+	}
+
+	// Take an entity out of the grid
+	void remove(int id) {
+		if (id >= (int)cellOf.size() || cellOf[id] == empty) return;
+		detach(id, cellOf[id]);
+		cellOf[id] = empty;
+	}
+
+	// Call whenever an entity moves, only touches the buckets if the entity changed cells
+	void update(int id, olc::vf2d pos) {
+		if (id >= (int)cellOf.size() || cellOf[id] == empty) {
+			insert(id, pos);
+			return;
+		}
+
+		int64_t key = keyOf(pos);
+		if (key == cellOf[id]) return;
+
+		detach(id, cellOf[id]);
+		cellOf[id] = key;
+		cells[key].push_back(id);
+	}
+
+	// Calls f(id) for every entity in the 3x3 block of cells around pos
+	template<typename F>
+	void query(olc::vf2d pos, F f) {
+		int32_t cx = cellCoord(pos.x);
+		int32_t cy = cellCoord(pos.y);
+
+		for (int32_t y = cy - 1; y <= cy + 1; y++) {
+			for (int32_t x = cx - 1; x <= cx + 1; x++) {
+				auto it = cells.find(pack(x, y));
+				if (it == cells.end()) continue;
+				for (int id : it->second) f(id);
+			}
+		}
+	}
+
+	// Calls f(id) for every entity in the cells covering [lo, hi] and the ring of cells around them
+	template<typename F>
+	void query(olc::vf2d lo, olc::vf2d hi, F f) {
+		int32_t x0 = cellCoord(lo.x) - 1, x1 = cellCoord(hi.x) + 1;
+		int32_t y0 = cellCoord(lo.y) - 1, y1 = cellCoord(hi.y) + 1;
+
+		for (int32_t y = y0; y <= y1; y++) {
+			for (int32_t x = x0; x <= x1; x++) {
+				auto it = cells.find(pack(x, y));
+				if (it == cells.end()) continue;
+				for (int id : it->second) f(id);
+			}
+		}
+	}
+
+	float getCellSize() { return cellSize; }
+
+private:
+
+	int32_t cellCoord(float v) {
+		return (int32_t)std::floor(v * invCellSize);
+	}
+
+	int64_t pack(int32_t x, int32_t y) {
+		return int64_t((uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y)));
+	}
+
+	int64_t keyOf(olc::vf2d pos) {
+		return pack(cellCoord(pos.x), cellCoord(pos.y));
+	}
+
+	// Swap and pop the id out of its bucket (buckets only hold a handful of entities)
+	// Empty buckets are kept around so entities moving back and forth don't reallocate
+	void detach(int id, int64_t key) {
+		auto it = cells.find(key);
+		if (it == cells.end()) return;
+
+		std::vector<int>& bucket = it->second;
+		for (size_t i = 0; i < bucket.size(); i++) {
+			if (bucket[i] == id) {
+				bucket[i] = bucket.back();
+				bucket.pop_back();
+				break;
+			}
+		}
+	}
+};
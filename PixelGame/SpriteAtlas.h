@@ -0,0 +1,286 @@
+#pragma once
+#include "../olcPixelGameEngine.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Sprites and sprite sheets packed into a few large pages
+// Every skin on a page shares its texture, so a crowd of entities with different skins
+// goes out as one decal batch instead of binding a texture per skin.
+// LevelCompiler packs Assets/images into atlas.bin, which the loader reads out of the pack
+// on its thread. The pages are uploaded through AssetCache, which hands out the regions.
+// Layout (little endian, like the packs):
+//   Header
+//   Page pages[pageCount]
+//   Entry entries[entryCount]
+//   uint32_t stringEnds[entryCount]	(end of every path in the string data)
+//   char strings[stringBytes]
+//   uint32_t pixels[]					(every page row by row, one after the other)
+class SpriteAtlas {
+
+public:
+
+	static constexpr uint32_t version = 1;
+
+	// Largest page the packer creates, anything bigger keeps its own texture
+	static constexpr int pageSize = 1024;
+
+	// Transparent pixels to the right and below every sprite so neighbours don't bleed in when filtered
+	static constexpr int padding = 1;
+
+	// Where a sprite ended up
+	struct Region {
+		int page;
+		olc::vi2d pos;
+		olc::vi2d size;
+	};
+
+	struct Header {
+		char magic[4];			// "PGAT"
+		uint32_t version;
+		uint64_t id;			// Hash of the contents, tells atlases from different packs apart
+		uint32_t pageCount;
+		uint32_t entryCount;
+		uint32_t stringBytes;
+		uint32_t reserved;
+	};
+
+	struct Page {
+		int32_t width, height;
+	};
+
+	struct Entry {
+		uint32_t page;
+		int32_t x, y;
+		int32_t width, height;
+	};
+
+	static_assert(sizeof(Header) == 32 && sizeof(Page) == 8 && sizeof(Entry) == 20 && sizeof(olc::Pixel) == 4, "Atlas structures must not be padded");
+
+private:
+
+	uint64_t id = 0;
+
+	// Page pixels (moved out once they are uploaded)
+	std::vector<std::unique_ptr<olc::Sprite>> pages;
+
+	// Path of every packed sprite -> where it is
+	std::unordered_map<std::string, Region> regions;
+
+public:
+
+	// Where the atlas lives in the pack
+	static std::string path() {
+		return "./Assets/data/atlas.bin";
+	}
+
+	// Packs sprites (path, image) into shelves, tallest first, opening pages as they fill up
+	// Sprites that don't fit on a page are left out
+	static SpriteAtlas pack(std::vector<std::pair<std::string, olc::Sprite*>> sprites) {
+
+		// Tallest first keeps the shelves tight, the path breaks ties so the result doesn't depend on the input order
+		std::sort(sprites.begin(), sprites.end(), [](const std::pair<std::string, olc::Sprite*>& a, const std::pair<std::string, olc::Sprite*>& b) {
+			if (a.second->height != b.second->height) return a.second->height > b.second->height;
+			if (a.second->width != b.second->width) return a.second->width > b.second->width;
+			return a.first < b.first;
+		});
+
+		struct Shelf {
+			int y, height, x;
+		};
+		struct Space {
+			std::vector<Shelf> shelves;
+			olc::vi2d used = { 0, 0 };
+		};
+		std::vector<Space> spaces;
+
+		SpriteAtlas atlas;
+		for (const std::pair<std::string, olc::Sprite*>& s : sprites) {
+
+			olc::vi2d size = { s.second->width, s.second->height };
+			olc::vi2d cell = size + olc::vi2d(padding, padding);
+			if (cell.x > pageSize || cell.y > pageSize || atlas.regions.count(s.first)) continue;
+
+			// First shelf it fits on, otherwise a new shelf on the first page with room left, otherwise a new page
+			Region region = { -1, { 0, 0 }, size };
+			for (int p = 0; p < int(spaces.size()) && region.page < 0; p++) {
+				for (Shelf& shelf : spaces[p].shelves) {
+					if (cell.y <= shelf.height && shelf.x + cell.x <= pageSize) {
+						region.page = p;
+						region.pos = { shelf.x, shelf.y };
+						shelf.x += cell.x;
+						break;
+					}
+				}
+				if (region.page < 0 && spaces[p].used.y + cell.y <= pageSize) {
+					spaces[p].shelves.push_back({ spaces[p].used.y, cell.y, cell.x });
+					region.page = p;
+					region.pos = { 0, spaces[p].used.y };
+					spaces[p].used.y += cell.y;
+				}
+			}
+			if (region.page < 0) {
+				spaces.emplace_back();
+				spaces.back().shelves.push_back({ 0, cell.y, cell.x });
+				spaces.back().used.y = cell.y;
+				region.page = int(spaces.size()) - 1;
+			}
+
+			Space& space = spaces[region.page];
+			space.used.x = std::max(space.used.x, region.pos.x + cell.x);
+			atlas.regions[s.first] = region;
+		}
+
+		// Pages are only as big as what is on them, new sprites are opaque black so the padding and gaps are cleared first
+		for (Space& space : spaces) {
+			atlas.pages.push_back(std::make_unique<olc::Sprite>(space.used.x, space.used.y));
+			std::fill(atlas.pages.back()->GetData(), atlas.pages.back()->GetData() + space.used.x * space.used.y, olc::BLANK);
+		}
+		for (const std::pair<std::string, olc::Sprite*>& s : sprites) {
+			auto it = atlas.regions.find(s.first);
+			if (it == atlas.regions.end()) continue;
+			const Region& r = it->second;
+			for (int y = 0; y < r.size.y; y++)
+				memcpy(atlas.pages[r.page]->GetData() + (r.pos.y + y) * atlas.pages[r.page]->width + r.pos.x,
+					s.second->GetData() + y * s.second->width, r.size.x * sizeof(olc::Pixel));
+		}
+
+		// FNV-1a over the entries and pixels
+		atlas.id = 14695981039346656037ULL;
+		auto hash = [&](const void* data, size_t bytes) {
+			for (size_t i = 0; i < bytes; i++) atlas.id = (atlas.id ^ ((const uint8_t*)data)[i]) * 1099511628211ULL;
+		};
+		for (const std::pair<std::string, Entry>& e : atlas.named()) {
+			hash(e.first.data(), e.first.size() + 1);
+			hash(&e.second, sizeof(e.second));
+		}
+		for (const std::unique_ptr<olc::Sprite>& page : atlas.pages) hash(page->GetData(), size_t(page->width) * page->height * sizeof(olc::Pixel));
+
+		return atlas;
+	}
+
+	void write(std::ostream& os) {
+
+		std::vector<std::pair<std::string, Entry>> sorted = named();
+
+		Header h;
+		memcpy(h.magic, "PGAT", 4);
+		h.version = version;
+		h.id = id;
+		h.pageCount = uint32_t(pages.size());
+		h.entryCount = uint32_t(sorted.size());
+		h.reserved = 0;
+
+		std::vector<Page> sizes;
+		for (const std::unique_ptr<olc::Sprite>& page : pages) sizes.push_back({ page->width, page->height });
+
+		std::vector<Entry> entries;
+		std::vector<uint32_t> ends;
+		std::string data;
+		for (const std::pair<std::string, Entry>& e : sorted) {
+			entries.push_back(e.second);
+			data += e.first;
+			ends.push_back(uint32_t(data.size()));
+		}
+		h.stringBytes = uint32_t(data.size());
+
+		os.write((const char*)&h, sizeof(h));
+		os.write((const char*)sizes.data(), sizes.size() * sizeof(Page));
+		os.write((const char*)entries.data(), entries.size() * sizeof(Entry));
+		os.write((const char*)ends.data(), ends.size() * sizeof(uint32_t));
+		os.write(data.data(), data.size());
+		for (const std::unique_ptr<olc::Sprite>& page : pages)
+			os.write((const char*)page->GetData(), size_t(page->width) * page->height * sizeof(olc::Pixel));
+	}
+
+	// Throws if the data isn't an atlas of this version or doesn't add up
+	static SpriteAtlas read(const char* data, size_t size) {
+
+		Header h;
+		if (size < sizeof(h)) throw std::runtime_error("Atlas is truncated");
+		memcpy(&h, data, sizeof(h));
+		if (memcmp(h.magic, "PGAT", 4) != 0) throw std::runtime_error("Not a sprite atlas");
+		if (h.version != version) throw std::runtime_error("Atlas is version " + std::to_string(h.version) + ", rebuild it");
+
+		// Sections follow the header back to back
+		uint64_t sizes = sizeof(h);
+		uint64_t entries = sizes + uint64_t(h.pageCount) * sizeof(Page);
+		uint64_t ends = entries + uint64_t(h.entryCount) * sizeof(Entry);
+		uint64_t strings = ends + uint64_t(h.entryCount) * sizeof(uint32_t);
+		uint64_t pixels = strings + h.stringBytes;
+		if (pixels > size) throw std::runtime_error("Atlas is broken");
+
+		std::vector<Page> pageSizes(h.pageCount);
+		if (h.pageCount > 0) memcpy(pageSizes.data(), data + sizes, pageSizes.size() * sizeof(Page));
+		uint64_t total = pixels;
+		for (const Page& p : pageSizes) {
+			if (p.width <= 0 || p.height <= 0 || p.width > pageSize || p.height > pageSize) throw std::runtime_error("Atlas is broken");
+			total += uint64_t(p.width) * p.height * sizeof(olc::Pixel);
+		}
+		if (total != size) throw std::runtime_error("Atlas is broken");
+
+		SpriteAtlas atlas;
+		atlas.id = h.id;
+		for (const Page& p : pageSizes) {
+			atlas.pages.push_back(std::make_unique<olc::Sprite>(p.width, p.height));
+			memcpy(atlas.pages.back()->GetData(), data + pixels, size_t(p.width) * p.height * sizeof(olc::Pixel));
+			pixels += uint64_t(p.width) * p.height * sizeof(olc::Pixel);
+		}
+
+		uint32_t begin = 0;
+		for (uint32_t i = 0; i < h.entryCount; i++) {
+			Entry e;
+			uint32_t end;
+			memcpy(&e, data + entries + i * sizeof(Entry), sizeof(e));
+			memcpy(&end, data + ends + i * sizeof(uint32_t), sizeof(end));
+			if (begin > end || end > h.stringBytes || e.page >= h.pageCount || e.x < 0 || e.y < 0 || e.width <= 0 || e.height <= 0 ||
+				e.x + e.width > pageSizes[e.page].width || e.y + e.height > pageSizes[e.page].height)
+				throw std::runtime_error("Atlas is broken");
+
+			atlas.regions[std::string(data + strings + begin, end - begin)] = { int(e.page), { e.x, e.y }, { e.width, e.height } };
+			begin = end;
+		}
+
+		return atlas;
+	}
+
+	// Where a sprite is, nullptr if it isn't in the atlas
+	const Region* find(const std::string& path) const {
+		auto it = regions.find(path);
+		return it != regions.end() ? &it->second : nullptr;
+	}
+
+	// Pixels of a page, the atlas forgets them (see AssetCache::insert)
+	std::unique_ptr<olc::Sprite> takePage(int page) {
+		return std::move(pages[page]);
+	}
+
+	// Unique name of a page, so the same page from two packs is only uploaded once
+	std::string pageKey(int page) const {
+		char key[32];
+		snprintf(key, sizeof(key), "atlas:%016llx:%d", (unsigned long long)id, page);
+		return key;
+	}
+
+	olc::Sprite* getPage(int page) { return pages[page].get(); }
+	int pageCount() const { return int(pages.size()); }
+	int spriteCount() const { return int(regions.size()); }
+
+private:
+
+	// Every entry with its path, in path order so the file comes out the same every time
+	std::vector<std::pair<std::string, Entry>> named() const {
+		std::vector<std::pair<std::string, Entry>> sorted;
+		for (const std::pair<const std::string, Region>& r : regions)
+			sorted.push_back({ r.first, { uint32_t(r.second.page), r.second.pos.x, r.second.pos.y, r.second.size.x, r.second.size.y } });
+		std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, Entry>& a, const std::pair<std::string, Entry>& b) { return a.first < b.first; });
+		return sorted;
+	}
+};
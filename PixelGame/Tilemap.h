@@ -0,0 +1,176 @@
+#pragma once
+#include "../olcPixelGameEngine.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Map made out of fixed size tiles
+// Only the indices of each tile are stored per cell, the pixels of each unique tile
+// live once in a tileset atlas which is drawn as decals (one per visible tile).
+// build() and load() only touch the cpu side so they can run on any thread,
+// upload() creates the texture and has to be called from the engine thread.
+class Tilemap {
+
+public:
+
+	// Index used for cells that have nothing to draw
+	static constexpr uint16_t empty = 0xFFFF;
+
+private:
+
+	int tileSize = 16;
+	olc::vi2d tiles = { 0, 0 };		// Width and height of the map in tiles
+
+	// Tile index for every cell (row major)
+	std::vector<uint16_t> cells;
+
+	// Unique tiles packed in rows of 'atlasColumns'
+	std::unique_ptr<olc::Sprite> atlas;
+	std::unique_ptr<olc::Decal> atlasDecal;
+	int atlasColumns = 16;
+	int tileCount = 0;
+
+public:
+
+	// Slices a full map image into tiles and keeps one copy of every unique tile
+	// Fully transparent tiles (and anything outside the image) are left empty
+	void build(olc::Sprite* map, int size, olc::vi2d dimensions) {
+
+		tileSize = size;
+		tiles = dimensions;
+		tileCount = 0;
+		cells.assign(size_t(tiles.x) * tiles.y, empty);
+
+		// Unique tile pixels, found by hashing the tile and then comparing against every tile with that hash
+		std::vector<uint32_t> unique;
+		std::unordered_multimap<uint32_t, int> lookup;
+		std::vector<uint32_t> tile(size_t(tileSize) * tileSize);
+
+		for (int ty = 0; ty < tiles.y; ty++) {
+			for (int tx = 0; tx < tiles.x; tx++) {
+
+				// Copy the tile out (GetPixel returns blank outside of the image)
+				bool visible = false;
+				uint32_t hash = 2166136261u;
+				for (int y = 0; y < tileSize; y++) {
+					for (int x = 0; x < tileSize; x++) {
+						uint32_t p = map->GetPixel(tx * tileSize + x, ty * tileSize + y).n;
+						tile[y * tileSize + x] = p;
+						visible |= (p >> 24) != 0;
+						hash = (hash ^ p) * 16777619u;
+					}
+				}
+				if (!visible) continue;
+
+				// Have we seen this tile before?
+				int index = -1;
+				auto range = lookup.equal_range(hash);
+				for (auto it = range.first; it != range.second; ++it) {
+					if (std::equal(tile.begin(), tile.end(), unique.begin() + size_t(it->second) * tile.size())) {
+						index = it->second;
+						break;
+					}
+				}
+
+				if (index < 0) {
+					if (tileCount >= empty) {
+						std::cout << "Too many unique tiles in map" << std::endl;
+						continue;
+					}
+					index = tileCount++;
+					unique.insert(unique.end(), tile.begin(), tile.end());
+					lookup.emplace(hash, index);
+				}
+
+				cells[ty * tiles.x + tx] = uint16_t(index);
+			}
+		}
+
+		// Pack the unique tiles into the atlas
+		createAtlas();
+		for (int i = 0; i < tileCount; i++) {
+			olc::vi2d origin = source(i);
+			for (int y = 0; y < tileSize; y++)
+				for (int x = 0; x < tileSize; x++)
+					atlas->SetPixel(origin.x + x, origin.y + y, unique[size_t(i) * tile.size() + y * tileSize + x]);
+		}
+	}
+
+	// Use an existing tileset (tiles laid out left to right, top to bottom) and a list of indices
+	void load(olc::Sprite* tileset, int size, olc::vi2d dimensions, const std::vector<int>& indices) {
+
+		tileSize = size;
+		tiles = dimensions;
+		cells.assign(size_t(tiles.x) * tiles.y, empty);
+
+		int columns = std::max(1, tileset->width / tileSize);
+		tileCount = columns * (tileset->height / tileSize);
+
+		for (size_t i = 0; i < cells.size() && i < indices.size(); i++) {
+			if (indices[i] >= 0 && indices[i] < tileCount) cells[i] = uint16_t(indices[i]);
+		}
+
+		// Copy the tileset into our own atlas layout
+		createAtlas();
+		for (int i = 0; i < tileCount; i++) {
+			olc::vi2d from = { (i % columns) * tileSize, (i / columns) * tileSize };
+			olc::vi2d to = source(i);
+			for (int y = 0; y < tileSize; y++)
+				for (int x = 0; x < tileSize; x++)
+					atlas->SetPixel(to.x + x, to.y + y, tileset->GetPixel(from.x + x, from.y + y));
+		}
+	}
+
+	// Create the atlas texture (needs the engine thread)
+	void upload() {
+		atlasDecal = atlas ? std::make_unique<olc::Decal>(atlas.get()) : nullptr;
+	}
+
+	// Submit every tile that is visible with the camera offsets as a decal
+	void draw(olc::PixelGameEngine* pge, olc::vf2d offsets) {
+
+		if (!atlasDecal) return;
+
+		// Keep the map locked to whole pixels
+		olc::vf2d origin = olc::vf2d(olc::vi2d(offsets));
+
+		// Visible range of tiles
+		int x0 = std::max(0, int(std::floor(-origin.x / tileSize)));
+		int y0 = std::max(0, int(std::floor(-origin.y / tileSize)));
+		int x1 = std::min(tiles.x - 1, int(std::floor((pge->ScreenWidth() - origin.x) / tileSize)));
+		int y1 = std::min(tiles.y - 1, int(std::floor((pge->ScreenHeight() - origin.y) / tileSize)));
+
+		olc::vf2d size = { float(tileSize), float(tileSize) };
+		for (int ty = y0; ty <= y1; ty++) {
+			for (int tx = x0; tx <= x1; tx++) {
+				uint16_t index = cells[ty * tiles.x + tx];
+				if (index == empty) continue;
+				olc::vf2d pos = origin + olc::vf2d(float(tx * tileSize), float(ty * tileSize));
+				pge->DrawPartialDecal(pos, atlasDecal.get(), source(index), size);
+			}
+		}
+	}
+
+	// Getters
+	int getTileSize() { return tileSize; }
+	olc::vi2d getTiles() { return tiles; }
+	int getTileCount() { return tileCount; }
+	olc::Decal* getDecal() { return atlasDecal.get(); }
+	uint16_t getTile(int x, int y) {
+		if (x < 0 || y < 0 || x >= tiles.x || y >= tiles.y) return empty;
+		return cells[y * tiles.x + x];
+	}
+
+private:
+
+	void createAtlas() {
+		int rows = std::max(1, (tileCount + atlasColumns - 1) / atlasColumns);
+		atlas = std::make_unique<olc::Sprite>(atlasColumns * tileSize, rows * tileSize);
+		atlasDecal.reset();
+	}
+
+	// Top left pixel of a tile inside the atlas
+	olc::vi2d source(int index) {
+		return { (index % atlasColumns) * tileSize, (index / atlasColumns) * tileSize };
+	}
+};
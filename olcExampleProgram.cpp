@@ -2,8 +2,15 @@
 #include "olcPixelGameEngine.h"
 #include "./PixelGame/Entity.h"
 #include "./PixelGame/Camera.h"
+#include "./PixelGame/SpatialHash.h"
+#include "./PixelGame/EntityPipeline.h"
+#include "./PixelGame/FixedStep.h"
+#include "./PixelGame/Profiler.h"
+#include "./PixelGame/Tilemap.h"
+#include "./PixelGame/LevelLoader.h"
 #include "./PixelGame/json.hpp"
 #include <istream>
+#include <chrono>
 
 class Game : public olc::PixelGameEngine
 {
@@ -18,9 +25,24 @@ public:
 	{
 		std::cout << "Initializing..." << std::endl;
 
-		//pack->AddFile("./Assets/data/leveldata.json");
-		//pack->SavePack("./Assets/data/0.dat", resourcePass);
+		// Read the password in to decrypt the resource packs
+		std::ifstream pass("./pass.txt");
+		std::getline(pass, resourcePass);
+
+		//olc::ResourcePack pack;
+		//pack.AddFile("./Assets/data/leveldata.json");
+		//pack.AddFile("./Assets/data/level0.bin");
+		//pack.AddFile("./Assets/data/atlas.bin");
+		//pack.SavePack("./Assets/data/0.dat", resourcePass);
+
+		// Map tiles get their own layer underneath everything else
+		mapLayer = CreateLayer();
+		EnableLayer(mapLayer, true);
 
+		// Debug shapes and the profiler overlay are drawn across all cores at the end of the frame
+		SetLayerDeferred(0, true);
+
+		// Nothing to show yet, so the first level is loaded up front
 		this->loadLevel();
 
 		return true;
@@ -28,53 +50,96 @@ public:
 
 	bool OnUserUpdate(float fElapsedTime) override
 	{
+		profiler.beginFrame(this);
 
-		// Get the camera offsets
-		cameraOffsets = player->getCamera()->getOffsets();
-
-		// Clear previous frame
-		Clear(olc::BLACK);
+		// Swap in a level that finished loading in the background
+		if (levelLoader.ready()) {
+			try {
+				this->applyLevel(levelLoader.take());
+			}
+			catch (std::exception& e) {
+				std::cout << "Unable to load level: " << e.what() << std::endl;
+			}
+		}
 
 		// Input
-		// Movement
-		if (GetKey(olc::Key::W).bHeld)			player->move(Player::Move::UP);
-		if (GetKey(olc::Key::S).bHeld)			player->move(Player::Move::DOWN);
-		if (GetKey(olc::Key::A).bHeld)			player->move(Player::Move::LEFT);
-		if (GetKey(olc::Key::D).bHeld)			player->move(Player::Move::RIGHT);
+		{
+			Profiler::ScopedTimer t(profiler, Profiler::INPUT);
+
+			// Debug, profiling and exit (movement is read by every physics step)
+			if (GetKey(olc::Key::F5).bPressed)		debugFlag = !debugFlag;
+			if (GetKey(olc::Key::F6).bPressed)		profilerFlag = !profilerFlag;
+			if (GetKey(olc::Key::F7).bPressed)		profiler.recordingCSV() ? profiler.closeCSV() : (void)profiler.openCSV("./profile.csv");
+			if (GetKey(olc::Key::F8).bPressed)		profiler.recordingTrace() ? profiler.closeTrace() : (void)profiler.openTrace("./profile.json");
+			if (GetKey(olc::Key::F9).bPressed)		this->streamLevel(currentLevel);
+			if (GetKey(olc::ESCAPE).bHeld)			exit(0);
+		}
 
-		// Debug and exit
-		if (GetKey(olc::Key::F5).bPressed)		debugFlag = !debugFlag;
-		if (GetKey(olc::ESCAPE).bHeld)			exit(0);
+		// Physics runs at its own fixed rate, as many steps as the frame time covers
+		int steps = physics.advance(fElapsedTime);
+		for (int i = 0; i < steps; i++) this->step(physics.getStep());
 
-		// Update position
-		player->updatePosition(fElapsedTime);
+		// Everything is drawn in between the last two steps
+		float alpha = physics.alpha();
+		renderOffsets = player->getCamera()->getOffsets(alpha);
+
+		// Clear previous frame (transparent so the map layer shows through)
+		Clear(olc::BLANK);
 
 		// Draw map to the screen
-		DrawSprite(cameraOffsets, mapSprite);
+		{
+			Profiler::ScopedTimer t(profiler, Profiler::MAP);
+			SetDrawTarget(mapLayer);
+			tilemap.draw(this, renderOffsets);
+			SetDrawTarget(nullptr);
+		}
 
-		// Update NPC positions and render
+		// Render NPCs and the player
 		SetPixelMode(olc::Pixel::ALPHA);
-
-		// Update and render entities
-		this->updateEntities(fElapsedTime);
-
-		// Draw Player
-		this->drawPlayer();
+		{
+			Profiler::ScopedTimer t(profiler, Profiler::DRAW);
+			this->drawEntities(alpha);
+			this->drawPlayer(alpha);
+		}
 
 		// Reset pixel mode since drawing with alpha is computationally heavy
 		SetPixelMode(olc::Pixel::NORMAL);
+
+		// Frame time histogram (not included in the timings)
+		if (profilerFlag) profiler.draw(this, { 2, ScreenHeight() - 66 });
+
+		profiler.endFrame();
+
+		return true;
+	}
+
+	Profiler& getProfiler() { return profiler; }
+
+	// Physics steps per second (independent of the frame rate)
+	void setPhysicsRate(float hz) {
+		physics.setRate(hz);
+		Entity::store.setStep(physics.getStep());
+	}
+
+	// Entities away from the screen take one slow step every 'steps' steps (1 steps everything every step)
+	void setSimulationLod(int steps) {
+		pipeline.setLod(steps);
 	}
 
 private:
 
 	// Constants
 	const float spriteSize = 16.0f;
-	const olc::vf2d spriteAdjust = { float(spriteSize) / 2, float(spriteSize) / 2 };
 
 	// Password for decrypting resource packs
 	std::string resourcePass;
 
+	// Camera offsets at the start of the current physics step and the ones to draw with
 	olc::vf2d cameraOffsets;
+	olc::vf2d renderOffsets;
+
+	// Fixed rate physics (60Hz unless setPhysicsRate says otherwise)
+	FixedStep physics;
 
 	// Relative starting position for the player (this will adjust offsets accordingly)
 	// {0, 0} will not offset anything... (the player will spawn at the normal center)
@@ -86,104 +151,132 @@ private:
 	// Vector to hold all aditional entities
 	std::vector<std::unique_ptr<Entity>> entities;
 
-	// Sprite and image data
-	olc::Sprite* mapSprite;
+	// Broadphase for entity collisions (one cell is one sprite wide)
+	SpatialHash grid{ spriteSize };
+
+	// Splits the entity update into phases that run across every core
+	EntityPipeline pipeline;
+
+	// Map tiles and the layer they are drawn on
+	Tilemap tilemap;
+	uint8_t mapLayer = 0;
 
 	// Look behind the curtain
 	bool debugFlag = false;
 
-	// Sprite and decal loaders
+	// Where does the frame go
+	Profiler profiler;
+	bool profilerFlag = false;
 
-	// Resources
-	olc::ResourcePack* pack = new olc::ResourcePack();
+	// Levels decoded in the background
+	LevelLoader levelLoader;
+	int currentLevel = 0;
 
 private:
 
+	// Blocking load, the game waits until the level is ready
 	void loadLevel(int level=0) {
-		// Quick cleanup from any previous levels that have been loaded
-		delete mapSprite;
-
-		using json = nlohmann::json;
-
-		// Read the password in to decrypt the resource pack
-		std::ifstream pass("./pass.txt");
-		std::getline(pass, resourcePass);
+		this->applyLevel(LevelLoader::decode(level, resourcePass, int(spriteSize)));
+	}
 
-		// Load the appropriate resource pack for the level
-		pack->LoadPack("./Assets/data/" + std::to_string(level) + ".dat", resourcePass);
+	// Start loading a level in the background, the current one keeps running until it is ready
+	void streamLevel(int level) {
+		if (levelLoader.loading()) return;
+		levelLoader.request(level, resourcePass, int(spriteSize));
+	}
 
-		// Load level data into input stream from buffer
-		olc::ResourceBuffer rb = pack->GetFileBuffer("./Assets/data/leveldata.json");
-		std::istream i(&rb);
-		
-		// Read level data
-		json j;
-		i >> j;
-		j = j[std::to_string(level)];
+	// Replace the current level with a decoded one (only the textures are created here)
+	void applyLevel(std::unique_ptr<LevelLoader::Level> level) {
+
+		currentLevel = level->number;
+
+		// Upload the skins before the old level goes away, skins both levels use are kept as they are
+		// Skins in the atlas only need their page uploaded, once for all of them
+		std::vector<AssetCache::Handle> skins;
+		std::vector<AssetCache::Handle> pages(level->atlas.pageCount());
+		for (LevelLoader::Skin& skin : level->skins) {
+			const SpriteAtlas::Region* region = level->atlas.find(skin.path);
+			if (region && !Entity::assets.contains(skin.path)) {
+				AssetCache::Handle& page = pages[region->page];
+				if (!page) page = Entity::assets.insert(level->atlas.pageKey(region->page), level->atlas.takePage(region->page));
+				skins.push_back(Entity::assets.insert(skin.path, page, region->pos, region->size));
+			}
+			else {
+				skins.push_back(Entity::assets.insert(skin.path, std::move(skin.sprite)));
+			}
+		}
 
-		// Load the map sprite
-		mapSprite = new olc::Sprite
-			("./Assets/images/sprites/" + j["name"].get<std::string>() + ".png", pack);
+		// Map tiles
+		tilemap = std::move(level->tilemap);
+		tilemap.upload();
 
 		// Load player and set initial position
-		startingPos = olc::vf2d(
-			{ 
-				j["player"]["location"][0].get<float>(),
-				j["player"]["location"][1].get<float>()
-			});
+		startingPos = level->player.pos;
 		player = std::make_unique<Player>(ScreenWidth(), ScreenHeight(), startingPos, 1000.0f);
-		
-		// Determine if the decal is going to be animated
-		std::string path;
-		if (j["player"]["animated"].get<bool>()) {
-			path = "./Assets/images/sprite_sheets/";
-		}
-		else {
-			path = "./Assets/images/sprites/";
+		player->setDecal(skins[level->player.skin]);
+		player->seedRandom(level->seed, 0);
+		if (level->skins[level->player.skin].sheet) player->setAnimation(level->skins[level->player.skin].sheet);
+
+		// Load NPCs
+		entities.clear();
+		grid.clear();
+		for (LevelLoader::Spawn& spawn : level->npcs) {
+
+			// Init the NPC and assign its skin
+			std::unique_ptr<NPC> newNPC = std::make_unique<NPC>(spawn.pos, ScreenWidth(), ScreenHeight());
+			newNPC->setDecal(skins[spawn.skin]);
+			newNPC->seedRandom(level->seed, entities.size() + 1);
+			if (level->skins[spawn.skin].sheet) newNPC->setAnimation(level->skins[spawn.skin].sheet);
+
+			// Add entity to the vector and the broadphase
+			grid.insert(int(entities.size()), spawn.pos);
+			entities.push_back(std::move(newNPC));
 		}
 
-		// Set the player decal
-		player->setDecal(path + j["player"]["skin"].get<std::string>() + ".png", pack);
-		player->initAnimations({ 11, 7, 7, 7, 7 }, 8);
+		// Frames can be drawn before the first step of the level
+		pipeline.reset();
+		pipeline.cull(entities, player->getCamera()->getOffsets(), { ScreenWidth(), ScreenHeight() });
+	}
 
-		// Load NPCs
-		olc::vf2d ePos;
-		for (auto& npc : j["npcs"]) {
+	// One physics step for the player and every entity
+	void step(float elapsedTime) {
 
-			// Check if the entity is animated
-			if (npc["animated"].get<bool>()) {
-				path = "./Assets/images/sprite_sheets/";
-			}
-			else {
-				path = "./Assets/images/sprites/";
-			}
+		// Keep where everything was so frames in between steps can be drawn smoothly
+		// (and collisions can be swept from there)
+		Entity::store.savePositions();
+		player->getCamera()->saveOffsets();
 
-			// Skin for npc
-			path += npc["skin"].get<std::string>() + ".png";
+		// Camera offsets at the start of the step
+		cameraOffsets = player->getCamera()->getOffsets();
 
-			// Location
-			ePos = {npc["location"][0].get<float>(), npc["location"][1].get<float>()};
+		// Update position
+		{
+			Profiler::ScopedTimer t(profiler, Profiler::PLAYER);
 
-			// Init the NPC and assign decal from the path
-			std::unique_ptr<NPC> newNPC = std::make_unique<NPC>(ePos, ScreenWidth(), ScreenHeight());
-			newNPC->setDecal(path, pack); 
+			// Movement
+			if (GetKey(olc::Key::W).bHeld)			player->move(Player::Move::UP);
+			if (GetKey(olc::Key::S).bHeld)			player->move(Player::Move::DOWN);
+			if (GetKey(olc::Key::A).bHeld)			player->move(Player::Move::LEFT);
+			if (GetKey(olc::Key::D).bHeld)			player->move(Player::Move::RIGHT);
 
-			// Add entity to the vector
-			entities.push_back(std::move(newNPC));
+			player->updatePosition(elapsedTime);
 		}
+
+		// Update NPC positions
+		this->updateEntities(elapsedTime);
 	}
 
-	void drawPlayer(){
+	void drawPlayer(float alpha){
 		// Get and adjust the position for the sprite
-		olc::vf2d pos = player->getPos();
+		olc::vf2d pos = player->getRenderPos(alpha);
 		olc::vf2d spriteSize = { player->r, player->r };
 		olc::vf2d adjust = pos - spriteSize;
 
 		// Get animation data for which frame to render
-		std::pair<olc::vf2d, olc::vf2d> animationData = player->am->getPartialCoords();
+		std::pair<olc::vf2d, olc::vf2d> animationData = player->getPartialCoords();
 
 		// Render the animation from the sprite sheet
-		DrawPartialDecal(adjust, player->am->getDecal(), animationData.first, animationData.second);
+		DrawPartialDecal(adjust, player->getDecal(), animationData.first, animationData.second);
 
 		// Debug information (camera, player hitbox, bounds, etc.)
 		if (debugFlag) {
@@ -196,44 +289,48 @@ private:
 
 	void updateEntities(float fElapsedTime) {
 
-		for (auto& e : entities) {
+		// Entities on or near the screen are updated every step and the rest now and then with a longer step,
+		// NPCs decide where to go and are integrated in one pass over the store
+		{
+			Profiler::ScopedTimer t(profiler, Profiler::INTEGRATION);
+			pipeline.cull(entities, cameraOffsets, { ScreenWidth(), ScreenHeight() });
+			pipeline.integrate(entities, Entity::store, fElapsedTime);
+			pipeline.animate(entities, Entity::animations, fElapsedTime);
+		}
 
-			// Get the entity's position
-			olc::vf2d pos = e->getPos();
+		// Pairs that touched at any point during the step are resolved where they first touched
+		{
+			Profiler::ScopedTimer t(profiler, Profiler::COLLISION);
+			olc::vf2d offsets = player->getCamera()->getOffsets();
+			pipeline.broadphase(entities, grid, *player, offsets, cameraOffsets);
+			pipeline.resolve(entities, *player, offsets, cameraOffsets, fElapsedTime);
 
-			// Dont render the entity if they are outside the screen boundaries
-			if ((pos + cameraOffsets).x + e->r < 0
-				|| (pos + cameraOffsets).x - e->r > ScreenWidth()
-				|| (pos + cameraOffsets).y + e->r < 0
-				|| (pos + cameraOffsets).y - e->r > ScreenHeight())
-				continue;
+			// Keep the broadphase up to date for the next step (collisions can move entities that weren't stepped)
+			pipeline.updateGrid(entities, grid);
+		}
+	}
 
-			// Check for collision with player
-			player->elasticCollision(e, cameraOffsets);
+	void drawEntities(float alpha) {
 
-			// Check for collision with other entities
-			for (auto& other : entities) {
-				if (other == e) continue;
-				else e->elasticCollision(other, cameraOffsets);
-			}
+		// The list is built in parallel but decals go in in entity order
+		for (const EntityPipeline::DrawItem& item : pipeline.buildDrawList(entities, renderOffsets, alpha)) {
 
-			// Update entity's position
-			e->updatePosition(fElapsedTime);
+			std::unique_ptr<Entity>& e = entities[item.entity];
 
 			// Entity specific actions and decal rendering
 			switch (e->getType()) {
 
 			case Entity::Type::NPC:
 
-
-				// Draw the NPC with the npcDecal
-				DrawDecal(pos - spriteAdjust + cameraOffsets, e->getDecal());
+				// Draw the NPC's skin (skins in the same atlas page end up in one batch)
+				DrawPartialDecal(item.pos, item.decal, item.source, item.size);
 
 				// Debug visuals (boundaries and entity radius)
 				if (debugFlag) {
+					olc::vf2d pos = e->getRenderPos(alpha);
 					Entity::Boundary b = e->getBoundary();
-					DrawCircle(pos + cameraOffsets, e->r, olc::BLUE);
-					DrawRect(olc::vf2d({ b.xLower - e->r, b.yLower - e->r }) + cameraOffsets, olc::vf2d({ b.xUpper + e->r, b.yUpper + e->r }), olc::BLUE);
+					DrawCircle(pos + renderOffsets, e->r, olc::BLUE);
+					DrawRect(olc::vf2d({ b.xLower - e->r, b.yLower - e->r }) + renderOffsets, olc::vf2d({ b.xUpper + e->r, b.yUpper + e->r }), olc::BLUE);
 				}
 				break;
 
@@ -253,7 +350,7 @@ struct AspectRatio
 	int y;
 };
 
-int main()
+int main(int argc, char* argv[])
 {
 	// Setup
 	AspectRatio ratio	= { 16, 9 };	// Aspect ratio
@@ -266,8 +363,42 @@ int main()
 
 	// Initialize the game
 	Game game;
+
+#if defined(OLC_PLATFORM_HEADLESS)
+	// Headless builds step the simulation a fixed number of frames as fast as possible
+	// Usage: PixelGame [frames] [timestep] [profile.csv|profile.json|-] [physics hz] [slow steps]
+	uint32_t frames	= argc > 1 ? uint32_t(std::stoul(argv[1])) : 3600;
+	float step		= argc > 2 ? std::stof(argv[2]) : 1.0f / 60.0f;
+	game.SetFixedTimeStep(step);
+	game.SetFrameLimit(frames);
+	if (argc > 4) game.setPhysicsRate(std::stof(argv[4]));
+	if (argc > 5) game.setSimulationLod(std::stoi(argv[5]));
+
+	// Per frame timings as a csv table or a chrome trace
+	if (argc > 3 && std::string(argv[3]) != "-") {
+		std::string profile = argv[3];
+		if (profile.size() > 4 && profile.substr(profile.size() - 4) == ".csv")
+			game.getProfiler().openCSV(profile);
+		else
+			game.getProfiler().openTrace(profile);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	if (game.Construct(width, height, pixel_size, pixel_size, false, false))
+		game.Start();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << game.GetFrameCount() << " frames in " << elapsed.count() << "s ("
+		<< elapsed.count() * 1000.0 / std::max(1u, game.GetFrameCount()) << "ms per frame)" << std::endl;
+
+	const olc::RenderStats& rs = game.GetRenderStats();
+	std::cout << "Last frame: " << rs.nDecals << " decals in " << rs.nBatches << " batches ("
+		<< rs.nDrawCalls << " draw calls, " << rs.nVertices << " vertices, " << rs.nAllocations << " allocations)" << std::endl;
+	std::cout << "Texture uploads: " << rs.nTextureUploads << " (" << rs.nUploadedPixels << " pixels)" << std::endl;
+#else
 	if (game.Construct(width, height, pixel_size, pixel_size, false, true))
 		game.Start();
+#endif
 
 	return 0;
 }
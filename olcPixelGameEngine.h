@@ -289,6 +289,9 @@ int main()
 #include <algorithm>
 #include <array>
 #include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 #define PGE_VER 214
 
@@ -337,7 +340,7 @@ namespace _gfs = std::filesystem;
 // O------------------------------------------------------------------------------O
 
 // Platform
-#if !defined(OLC_PLATFORM_WINAPI) && !defined(OLC_PLATFORM_X11) && !defined(OLC_PLATFORM_GLUT)
+#if !defined(OLC_PLATFORM_WINAPI) && !defined(OLC_PLATFORM_X11) && !defined(OLC_PLATFORM_GLUT) && !defined(OLC_PLATFORM_HEADLESS)
 #if defined(_WIN32)
 #define OLC_PLATFORM_WINAPI
 #endif
@@ -350,7 +353,12 @@ namespace _gfs = std::filesystem;
 #endif
 
 // Renderer
-#if !defined(OLC_GFX_OPENGL10) && !defined(OLC_GFX_OPENGL33) && !defined(OLC_GFX_DIRECTX10)
+// No window means nothing to render into
+#if defined(OLC_PLATFORM_HEADLESS) && !defined(OLC_GFX_HEADLESS)
+#define OLC_GFX_HEADLESS
+#endif
+
+#if !defined(OLC_GFX_OPENGL10) && !defined(OLC_GFX_OPENGL33) && !defined(OLC_GFX_DIRECTX10) && !defined(OLC_GFX_HEADLESS)
 #define OLC_GFX_OPENGL10
 #endif
 
@@ -403,6 +411,32 @@ namespace X11
 }
 #endif
 
+// Memory mapped resource packs
+#if defined(OLC_PLATFORM_WINAPI)
+#define OLC_RESOURCEPACK_MMAP_WINAPI
+#elif defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define OLC_RESOURCEPACK_MMAP_POSIX
+#endif
+
+// Vectorised span blending (SSE2 on any x64, AVX2 when the compiler targets it)
+#if !defined(OLC_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define OLC_SIMD_SSE2
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OLC_SIMD_AVX2
+#endif
+#endif
+
+// Threads that rasterise deferred layers, one per core unless it is pinned (e.g. to check them on any machine)
+#if !defined(OLC_RASTER_WORKERS)
+#define OLC_RASTER_WORKERS std::thread::hardware_concurrency()
+#endif
+
 #if defined(OLC_PLATFORM_GLUT)
 #define PGE_USE_CUSTOM_START
 #if defined(__linux__)
@@ -604,7 +638,14 @@ namespace olc
 	// O------------------------------------------------------------------------------O
 	struct ResourceBuffer : public std::streambuf
 	{
-		ResourceBuffer(std::ifstream& ifs, uint32_t offset, uint32_t size);
+		ResourceBuffer(std::ifstream& ifs, uint64_t offset, uint64_t size);
+		// View over memory owned by someone else (memory mapped packs), nothing is copied
+		ResourceBuffer(const char* data, uint64_t size);
+		// Takes over memory that has already been decoded (compressed pack entries)
+		ResourceBuffer(std::vector<char>&& data);
+		// The whole file, wherever it lives
+		const char* Data() const;
+		size_t Size() const;
 		std::vector<char> vMemory;
 	};
 
@@ -614,16 +655,83 @@ namespace olc
 		ResourcePack();
 		~ResourcePack();
 		bool AddFile(const std::string& sFile);
-		bool LoadPack(const std::string& sFile, const std::string& sKey);
-		bool SavePack(const std::string& sFile, const std::string& sKey);
+		// Reads version 1 and version 2 packs
+		// bMemoryMap maps the whole pack into memory, file buffers are then views into
+		// the mapping and must not outlive the pack
+		bool LoadPack(const std::string& sFile, const std::string& sKey, bool bMemoryMap = false);
+		// Always writes a version 2 pack, with bCompress entries are stored compressed
+		// whenever that makes them noticeably smaller
+		bool SavePack(const std::string& sFile, const std::string& sKey, bool bCompress = true);
 		ResourceBuffer GetFileBuffer(const std::string& sFile);
 		bool Loaded();
+		bool Mapped();
+		uint32_t Version();
 	private:
-		struct sResourceFile { uint32_t nSize; uint32_t nOffset; };
-		std::map<std::string, sResourceFile> mapFiles;
+		// Version 2 layout (little endian):
+		//   sPackHeader
+		//   index: nEntries x sPackEntry sorted by hash, followed by the paths (scrambled with the key)
+		//   file data, every entry starts on a multiple of nAlignment so it can be used straight from a mapping
+		// Version 1 packs have no header, they start with the size of their index instead
+		struct sPackHeader
+		{
+			char sMagic[4];
+			uint32_t nVersion;
+			uint32_t nAlignment;
+			uint32_t nEntries;
+			uint64_t nIndexOffset;
+			uint64_t nIndexSize;
+		};
+		struct sPackEntry
+		{
+			uint64_t nHash;
+			uint64_t nOffset;
+			uint64_t nSize;			// Size of the file
+			uint64_t nStoredSize;	// Size of the file in the pack
+			uint32_t nPathOffset;	// From the end of the entries
+			uint32_t nPathSize;
+			uint32_t nFlags;
+			uint32_t nReserved;
+		};
+		static constexpr uint32_t nPackVersionLatest = 2;
+		static constexpr uint32_t nPackAlignment = 4096;
+		static constexpr uint32_t nFlagCompressed = 0x01;
+
+		struct sResourceFile
+		{
+			uint64_t nHash = 0;
+			std::string sPath;
+			uint64_t nSize = 0;
+			uint64_t nOffset = 0;
+			uint64_t nStoredSize = 0;
+			uint32_t nFlags = 0;
+		};
+		// Sorted by hash (then path), lookups are a binary search
+		std::vector<sResourceFile> vFiles;
+		uint32_t nVersion = 0;
+		uint64_t nPackSize = 0;
 		std::ifstream baseFile;
 		std::vector<char> scramble(const std::vector<char>& data, const std::string& key);
 		std::string makeposix(const std::string& path);
+
+		// Memory mapped pack
+		const char* pMapped = nullptr;
+		size_t nMappedSize = 0;
+#if defined(OLC_RESOURCEPACK_MMAP_WINAPI)
+		HANDLE hMappedFile = INVALID_HANDLE_VALUE;
+		HANDLE hMapping = nullptr;
+#endif
+		bool MapFile(const std::string& sFile);
+		void UnmapFile();
+
+		bool ReadBytes(uint64_t nOffset, char* pDst, size_t nSize);
+		bool ReadIndexV1(const std::string& sKey);
+		bool ReadIndexV2(const std::string& sKey);
+		const sResourceFile* FindFile(const std::string& sFile);
+		static uint64_t hash(const std::string& s);
+
+		// Small LZ4 block format codec
+		static std::vector<char> compress(const char* src, size_t nSize);
+		static bool decompress(const char* src, size_t nSrcSize, char* dst, size_t nDstSize);
 	};
 
 
@@ -727,26 +835,175 @@ namespace olc
 	// | Auxilliary components internal to engine                                     |
 	// O------------------------------------------------------------------------------O
 
+	// Vertex data points into the arena of the layer the decal was drawn on,
+	// so an instance is only valid until that layer has been drawn
 	struct DecalInstance
 	{
 		olc::Decal* decal = nullptr;
-		std::vector<olc::vf2d> pos;
-		std::vector<olc::vf2d> uv;
-		std::vector<float> w;
-		std::vector<olc::Pixel> tint;
+		olc::vf2d* pos = nullptr;
+		olc::vf2d* uv = nullptr;
+		float* w = nullptr;
+		olc::Pixel* tint = nullptr;
 		olc::DecalMode mode = olc::DecalMode::NORMAL;
 		uint32_t points = 0;
 	};
 
+	// Frame scoped bump allocator for decal vertex data
+	// Blocks are kept when it is reset, so once they have grown to fit a frame nothing else is allocated
+	class DecalArena
+	{
+	public:
+		DecalArena() = default;
+		DecalArena(const DecalArena&) = delete;
+		DecalArena& operator=(const DecalArena&) = delete;
+		DecalArena(DecalArena&&) = default;
+		DecalArena& operator=(DecalArena&&) = default;
+
+		void* Allocate(size_t nBytes);
+		// Everything handed out so far becomes invalid
+		void Reset();
+		// Heap allocations since the last Reset()
+		uint32_t Allocations() const;
+
+	private:
+		struct Block
+		{
+			std::unique_ptr<uint8_t[]> pData;
+			size_t nSize = 0;
+		};
+		std::vector<Block> vBlocks;
+		size_t nBlock = 0;
+		size_t nUsed = 0;
+		uint32_t nAllocations = 0;
+		static constexpr size_t nBlockSize = 64 * 1024;
+	};
+
+	// CPU draw recorded on a deferred layer (see SetLayerDeferred)
+	struct RasterCommand
+	{
+		enum Type : uint8_t { PIXEL, FILL, SPRITE };
+		uint8_t nType = PIXEL;
+		uint8_t nMode = 0;		// Pixel::Mode it was drawn with
+		float fBlend = 1.0f;
+		olc::Pixel p;
+		olc::vi2d tl;			// Pixels it can touch, br is exclusive
+		olc::vi2d br;
+		uint32_t nSprite = 0;	// SPRITE only, index into the layer's vRasterSprites
+	};
+
+	// The visible part of the source is copied when the blit is recorded, so the sprite
+	// can be changed or freed straight after without affecting the result
+	struct RasterSprite
+	{
+		size_t nPixels = 0;		// Copied rows in the layer's vRasterPixels
+		olc::vi2d pos;			// Where the copied part goes (as if it was the whole sprite)
+		olc::vi2d size;
+		uint32_t nScale = 1;
+		uint8_t nFlip = 0;
+	};
+
+	// Threads that work through a numbered set of jobs
+	// Jobs are dealt out round robin, a thread that runs out takes jobs off the back of the others.
+	class WorkerPool
+	{
+	public:
+		// nWorkers includes the thread calling Run()
+		WorkerPool(uint32_t nWorkers);
+		~WorkerPool();
+
+		// Calls job(index, worker) for every index below nJobs and returns once they have all finished
+		void Run(uint32_t nJobs, const std::function<void(uint32_t, uint32_t)>& job);
+		uint32_t Workers() const;
+
+	private:
+		struct Queue
+		{
+			std::mutex mux;
+			std::deque<uint32_t> jobs;
+		};
+
+		void Worker(uint32_t nWorker);
+		void Work(uint32_t nWorker);
+		bool Take(uint32_t nWorker, uint32_t& nJob);
+
+		uint32_t nWorkers = 1;
+		std::unique_ptr<Queue[]> pQueues;
+		std::vector<std::thread> vThreads;
+		std::mutex mux;
+		std::condition_variable cvStart;
+		std::condition_variable cvDone;
+		const std::function<void(uint32_t, uint32_t)>* pJob = nullptr;
+		uint64_t nGeneration = 0;
+		uint32_t nBusy = 0;
+		bool bQuit = false;
+	};
+
+	// Time spent in each stage of an olc_CoreUpdate (seconds)
+	struct FrameTimings
+	{
+		float fUserUpdate = 0.0f;
+		float fRasterize = 0.0f;
+		float fTextureUpload = 0.0f;
+		float fDecalSubmit = 0.0f;
+		float fDisplayFrame = 0.0f;
+	};
+
+	// One corner of a batched decal triangle
+	struct DecalVertex
+	{
+		float pos[3];		// x, y and w (perspective correction)
+		olc::vf2d uv;
+		olc::Pixel tint;
+	};
+
+	// Consecutive decals sharing a texture and mode, flattened into a triangle list
+	struct DecalBatch
+	{
+		olc::Decal* decal = nullptr;
+		olc::DecalMode mode = olc::DecalMode::NORMAL;
+		const olc::DecalVertex* vertices = nullptr;
+		uint32_t count = 0;
+	};
+
+	// What the last frame sent to the renderer
+	struct RenderStats
+	{
+		uint32_t nDecals = 0;		// Decal instances submitted
+		uint32_t nBatches = 0;		// Batched draws
+		uint32_t nDrawCalls = 0;	// Every draw, including layer quads and unbatched decals
+		uint32_t nVertices = 0;		// Vertices in batched draws
+		uint32_t nAllocations = 0;	// Heap allocations made recording and batching decals
+		uint32_t nTextureUploads = 0;	// Layer texture uploads (whole or partial)
+		uint32_t nUploadedPixels = 0;	// Pixels sent with them
+	};
+
+	// Region of a layer that has been drawn to, br is exclusive
+	struct DirtyRect
+	{
+		olc::vi2d tl;
+		olc::vi2d br;
+		int32_t area() const { return (br.x - tl.x) * (br.y - tl.y); }
+	};
+
 	struct LayerDesc
 	{
 		olc::vf2d vOffset = { 0, 0 };
 		olc::vf2d vScale = { 1, 1 };
 		bool bShow = false;
-		bool bUpdate = false;
+		bool bUpdate = false;		// Upload the whole layer, set this after writing to pDrawTarget directly
 		olc::Sprite* pDrawTarget = nullptr;
+		std::vector<DirtyRect> vDirty;	// Drawn to since the last upload
+		std::vector<DirtyRect> vDrawn;	// Drawn to since the last Clear()
+		bool bCleared = false;		// Everything outside vDrawn is pClear
+		olc::Pixel pClear = olc::BLANK;
+		bool bDeferred = false;
+		std::vector<RasterCommand> vRaster;	// Draws waiting for the end of the frame
+		std::vector<RasterSprite> vRasterSprites;
+		std::vector<olc::Pixel> vRasterPixels;
 		uint32_t nResID = 0;
 		std::vector<DecalInstance> vecDecalInstance;
+		DecalArena decalArena;
+		bool bSortDecals = false;
 		olc::Pixel tint = olc::WHITE;
 		std::function<void()> funcHook = nullptr;
 	};
@@ -763,8 +1020,10 @@ namespace olc
 		virtual void	   SetDecalMode(const olc::DecalMode& mode) = 0;
 		virtual void       DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint) = 0;
 		virtual void       DrawDecal(const olc::DecalInstance& decal) = 0;
+		virtual void       DrawDecalBatch(const olc::DecalBatch& batch) = 0;
 		virtual uint32_t   CreateTexture(const uint32_t width, const uint32_t height, const bool filtered = false) = 0;
 		virtual void       UpdateTexture(uint32_t id, olc::Sprite* spr) = 0;
+		virtual void       UpdateTextureRegion(uint32_t id, olc::Sprite* spr, const olc::vi2d& pos, const olc::vi2d& size) = 0;
 		virtual void       ReadTexture(uint32_t id, olc::Sprite* spr) = 0;
 		virtual uint32_t   DeleteTexture(const uint32_t id) = 0;
 		virtual void       ApplyTexture(uint32_t id) = 0;
@@ -862,6 +1121,16 @@ namespace olc
 		const olc::vi2d& GetPixelSize() const;
 		// Gets actual pixel scale
 		const olc::vi2d& GetScreenPixelSize() const;
+		// Pass a constant elapsed time to OnUserUpdate instead of the wall clock, 0 to disable
+		void SetFixedTimeStep(float fStep);
+		// Stop the engine after this many frames, 0 to run forever
+		void SetFrameLimit(uint32_t nFrames);
+		// Number of frames run since Start()
+		uint32_t GetFrameCount() const;
+		// Stage timings of the last completed frame
+		const olc::FrameTimings& GetFrameTimings() const;
+		// Decals, batches and draw calls of the last completed frame
+		const olc::RenderStats& GetRenderStats() const;
 
 	public: // CONFIGURATION ROUTINES
 		// Layer targeting functions
@@ -873,6 +1142,13 @@ namespace olc
 		void SetLayerScale(uint8_t layer, float x, float y);
 		void SetLayerTint(uint8_t layer, const olc::Pixel& tint);
 		void SetLayerCustomRenderFunction(uint8_t layer, std::function<void()> f);
+		// Let the layer reorder its decals by texture and mode so they batch better
+		// (only for layers where the decals don't overlap, or the order doesn't matter)
+		void SetLayerSortDecals(uint8_t layer, bool bSort);
+		// Record CPU drawing to this layer and rasterise it across worker threads at the end of the frame,
+		// the result is the same as drawing straight away but the layer's sprite is only up to date after
+		// the frame (sprites drawn to it are copied, so they can change or go away straight after)
+		void SetLayerDeferred(uint8_t layer, bool bDeferred);
 
 		std::vector<LayerDesc>& GetLayers();
 		uint32_t CreateLayer();
@@ -996,11 +1272,19 @@ namespace olc
 		float		fFrameTimer = 1.0f;
 		float		fLastElapsed = 0.0f;
 		int			nFrameCount = 0;
+		float		fFixedTimeStep = 0.0f;
+		uint32_t	nFrameLimit = 0;
+		uint32_t	nTotalFrames = 0;
+		FrameTimings sFrameTimings;
+		RenderStats sRenderStats;
+		std::vector<DecalVertex> vBatchVertices;
+		uint32_t	nDecalAllocations = 0;
 		Sprite* fontSprite = nullptr;
 		Decal* fontDecal = nullptr;
 		Sprite* pDefaultDrawTarget = nullptr;
 		std::vector<LayerDesc> vLayers;
 		uint8_t		nTargetLayer = 0;
+		int32_t		nDirtyLayer = -1;	// Layer the draw target belongs to (-1 for other sprites)
 		uint32_t	nLastFPS = 0;
 		bool        bPixelCohesion = false;
 		DecalMode   nDecalMode = DecalMode::NORMAL;
@@ -1037,6 +1321,31 @@ namespace olc
 		void olc_UpdateViewport();
 		void olc_ConstructFontSheet();
 		void olc_CoreUpdate();
+		void olc_DrawLayerDecals(LayerDesc& layer, RenderStats& stats);
+		DecalInstance& olc_NewDecalInstance(olc::Decal* decal, uint32_t nPoints);
+		void olc_SetDecalQuad(DecalInstance& di, const olc::vf2d& tl, const olc::vf2d& br, const olc::vf2d& uvtl, const olc::vf2d& uvbr, const olc::Pixel& tint);
+
+		// Row primitives for the blits, for NORMAL, MASK and ALPHA they write exactly what Draw() would
+		static void olc_BlendSpan(olc::Pixel* dst, const olc::Pixel* src, int32_t n, Pixel::Mode mode, float fBlend);
+		static void olc_FillSpan(olc::Pixel* dst, const olc::Pixel p, int32_t n, Pixel::Mode mode, float fBlend);
+		static void olc_BlitSprite(Sprite* target, const olc::vi2d& tl, const olc::vi2d& br, int32_t x, int32_t y, const Pixel* pSource, int32_t nStride, int32_t w, int32_t h, uint32_t scale, uint8_t flip, Pixel::Mode mode, float fBlend, std::vector<olc::Pixel>& vRow);
+		bool olc_DrawSpriteSpans(int32_t x, int32_t y, const Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip);
+		std::vector<olc::Pixel> vSpanRow;
+
+		// Deferred layers, their draws are binned into tiles and rasterised across the pool
+		void olc_FlushLayer(LayerDesc& layer);
+		void olc_FlushSource(const Sprite* sprite);
+		static void olc_Rasterize(const LayerDesc& layer, const RasterCommand& c, const olc::vi2d& tileTL, const olc::vi2d& tileBR, std::vector<olc::Pixel>& vRow);
+		std::unique_ptr<WorkerPool> pRasterPool;
+		std::vector<std::vector<uint32_t>> vRasterBins;
+		std::vector<uint32_t> vRasterTiles;
+		std::vector<std::vector<olc::Pixel>> vRasterRows;
+		static constexpr int32_t nRasterTile = 64;
+
+		// Dirty rectangle tracking for the draw target's layer
+		void olc_MarkDirty(int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+		void olc_AddDirtyRect(std::vector<DirtyRect>& vRects, const DirtyRect& r);
+		void olc_UploadLayer(LayerDesc& layer, RenderStats& stats);
 		void olc_PrepareEngine();
 		void olc_UpdateMouseState(int32_t button, bool state);
 		void olc_UpdateKeyState(int32_t key, bool state);
@@ -1489,15 +1798,37 @@ namespace olc
 	//=============================================================
 	// Resource Packs - Allows you to store files in one large 
 	// scrambled file - Thanks MaGetzUb for debugging a null char in std::stringstream bug
-	ResourceBuffer::ResourceBuffer(std::ifstream& ifs, uint32_t offset, uint32_t size)
+	ResourceBuffer::ResourceBuffer(std::ifstream& ifs, uint64_t offset, uint64_t size)
+	{
+		vMemory.resize(size_t(size));
+		ifs.seekg(std::streamoff(offset)); ifs.read(vMemory.data(), vMemory.size());
+		setg(vMemory.data(), vMemory.data(), vMemory.data() + vMemory.size());
+	}
+
+	ResourceBuffer::ResourceBuffer(const char* data, uint64_t size)
+	{
+		// streambuf wants mutable pointers, but only the get area is ever used
+		char* p = const_cast<char*>(data);
+		setg(p, p, p + size);
+	}
+
+	ResourceBuffer::ResourceBuffer(std::vector<char>&& data) : vMemory(std::move(data))
+	{
+		setg(vMemory.data(), vMemory.data(), vMemory.data() + vMemory.size());
+	}
+
+	const char* ResourceBuffer::Data() const
+	{
+		return eback();
+	}
+
+	size_t ResourceBuffer::Size() const
 	{
-		vMemory.resize(size);
-		ifs.seekg(offset); ifs.read(vMemory.data(), vMemory.size());
-		setg(vMemory.data(), vMemory.data(), vMemory.data() + size);
+		return size_t(egptr() - eback());
 	}
 
 	ResourcePack::ResourcePack() { }
-	ResourcePack::~ResourcePack() { baseFile.close(); }
+	ResourcePack::~ResourcePack() { baseFile.close(); UnmapFile(); }
 
 	bool ResourcePack::AddFile(const std::string& sFile)
 	{
@@ -1506,146 +1837,462 @@ namespace olc
 		if (_gfs::exists(file))
 		{
 			sResourceFile e;
-			e.nSize = (uint32_t)_gfs::file_size(file);
-			e.nOffset = 0; // Unknown at this stage			
-			mapFiles[file] = e;
+			e.nHash = hash(file);
+			e.sPath = file;
+			e.nSize = (uint64_t)_gfs::file_size(file);
+			e.nOffset = 0; // Unknown at this stage
+			e.nStoredSize = e.nSize;
+
+			auto it = std::lower_bound(vFiles.begin(), vFiles.end(), e, [](const sResourceFile& a, const sResourceFile& b)
+				{ return a.nHash < b.nHash || (a.nHash == b.nHash && a.sPath < b.sPath); });
+			if (it != vFiles.end() && it->sPath == file) *it = e;
+			else vFiles.insert(it, e);
 			return true;
 		}
 		return false;
 	}
 
-	bool ResourcePack::LoadPack(const std::string& sFile, const std::string& sKey)
+	bool ResourcePack::LoadPack(const std::string& sFile, const std::string& sKey, bool bMemoryMap)
 	{
-		// Open the resource file
-		baseFile.open(sFile, std::ifstream::binary);
-		if (!baseFile.is_open()) return false;
+		// Forget any previously loaded pack
+		vFiles.clear();
+		nVersion = 0;
+		nPackSize = 0;
+		if (baseFile.is_open()) baseFile.close();
+		UnmapFile();
+
+		if (bMemoryMap && MapFile(sFile))
+		{
+			nPackSize = nMappedSize;
+		}
+		else
+		{
+			// Open the resource file
+			baseFile.open(sFile, std::ifstream::binary);
+			if (!baseFile.is_open()) return false;
+			baseFile.seekg(0, std::ios::end);
+			nPackSize = uint64_t(baseFile.tellg());
+		}
 
+		// Version 2 packs start with a magic number, version 1 packs with the index size
+		char sMagic[4] = { 0 };
+		bool bLoaded = ReadBytes(0, sMagic, 4);
+		if (bLoaded) bLoaded = memcmp(sMagic, "OLCR", 4) == 0 ? ReadIndexV2(sKey) : ReadIndexV1(sKey);
+
+		// Whatever the index claims, nothing may point outside of the pack
+		for (auto& e : vFiles)
+			if (e.nOffset > nPackSize || e.nStoredSize > nPackSize - e.nOffset) bLoaded = false;
+
+		if (!bLoaded)
+		{
+			vFiles.clear();
+			if (baseFile.is_open()) baseFile.close();
+			UnmapFile();
+			return false;
+		}
+
+		std::sort(vFiles.begin(), vFiles.end(), [](const sResourceFile& a, const sResourceFile& b)
+			{ return a.nHash < b.nHash || (a.nHash == b.nHash && a.sPath < b.sPath); });
+
+		// Don't close base file! we will provide a stream
+		// pointer when the file is requested
+		return true;
+	}
+
+	bool ResourcePack::ReadBytes(uint64_t nOffset, char* pDst, size_t nSize)
+	{
+		if (nOffset > nPackSize || nSize > nPackSize - nOffset) return false;
+		if (pMapped)
+		{
+			memcpy(pDst, pMapped + nOffset, nSize);
+			return true;
+		}
+		baseFile.clear();
+		baseFile.seekg(std::streamoff(nOffset));
+		baseFile.read(pDst, std::streamsize(nSize));
+		return size_t(baseFile.gcount()) == nSize;
+	}
+
+	bool ResourcePack::ReadIndexV1(const std::string& sKey)
+	{
 		// 1) Read Scrambled index
 		uint32_t nIndexSize = 0;
-		baseFile.read((char*)&nIndexSize, sizeof(uint32_t));
+		if (!ReadBytes(0, (char*)&nIndexSize, sizeof(uint32_t))) return false;
 
 		std::vector<char> buffer(nIndexSize);
-		for (uint32_t j = 0; j < nIndexSize; j++)
-			buffer[j] = baseFile.get();
+		if (!ReadBytes(sizeof(uint32_t), buffer.data(), nIndexSize)) return false;
+		buffer = scramble(buffer, sKey);
 
-		std::vector<char> decoded = scramble(buffer, sKey);
+		// 2) Read Map
 		size_t pos = 0;
-		auto read = [&decoded, &pos](char* dst, size_t size) {
-			memcpy((void*)dst, (const void*)(decoded.data() + pos), size);
+		auto read = [&](char* dst, size_t size) {
+			if (size > buffer.size() - pos) return false;
+			memcpy(dst, buffer.data() + pos, size);
 			pos += size;
+			return true;
 		};
 
-		auto get = [&read]() -> int {
-			char c;
-			read(&c, 1);
-			return c;
-		};
-
-		// 2) Read Map
 		uint32_t nMapEntries = 0;
-		read((char*)&nMapEntries, sizeof(uint32_t));
+		if (!read((char*)&nMapEntries, sizeof(uint32_t))) return false;
 		for (uint32_t i = 0; i < nMapEntries; i++)
 		{
 			uint32_t nFilePathSize = 0;
-			read((char*)&nFilePathSize, sizeof(uint32_t));
+			if (!read((char*)&nFilePathSize, sizeof(uint32_t)) || nFilePathSize > buffer.size()) return false;
+
+			sResourceFile e;
+			e.sPath.resize(nFilePathSize);
+			if (!read(&e.sPath[0], nFilePathSize)) return false;
+
+			uint32_t nSize = 0, nOffset = 0;
+			if (!read((char*)&nSize, sizeof(uint32_t)) || !read((char*)&nOffset, sizeof(uint32_t))) return false;
+			e.nHash = hash(e.sPath);
+			e.nSize = nSize;
+			e.nStoredSize = nSize;
+			e.nOffset = nOffset;
+			vFiles.push_back(e);
+		}
+
+		nVersion = 1;
+		return true;
+	}
 
-			std::string sFileName(nFilePathSize, ' ');
-			for (uint32_t j = 0; j < nFilePathSize; j++)
-				sFileName[j] = get();
+	bool ResourcePack::ReadIndexV2(const std::string& sKey)
+	{
+		sPackHeader header;
+		if (!ReadBytes(0, (char*)&header, sizeof(sPackHeader))) return false;
+		if (header.nVersion != 2) return false;
+		if (header.nIndexSize > nPackSize || uint64_t(header.nEntries) * sizeof(sPackEntry) > header.nIndexSize) return false;
+
+		std::vector<char> buffer(size_t(header.nIndexSize));
+		if (!ReadBytes(header.nIndexOffset, buffer.data(), buffer.size())) return false;
+		buffer = scramble(buffer, sKey);
+
+		const char* pPaths = buffer.data() + size_t(header.nEntries) * sizeof(sPackEntry);
+		const size_t nPathsSize = buffer.size() - size_t(header.nEntries) * sizeof(sPackEntry);
+
+		vFiles.reserve(header.nEntries);
+		for (uint32_t i = 0; i < header.nEntries; i++)
+		{
+			sPackEntry p;
+			memcpy(&p, buffer.data() + size_t(i) * sizeof(sPackEntry), sizeof(sPackEntry));
+			if (p.nPathOffset > nPathsSize || p.nPathSize > nPathsSize - p.nPathOffset) return false;
+			if ((p.nFlags & nFlagCompressed) == 0 && p.nStoredSize != p.nSize) return false;
 
 			sResourceFile e;
-			read((char*)&e.nSize, sizeof(uint32_t));
-			read((char*)&e.nOffset, sizeof(uint32_t));
-			mapFiles[sFileName] = e;
+			e.sPath.assign(pPaths + p.nPathOffset, p.nPathSize);
+			e.nHash = p.nHash;
+			e.nSize = p.nSize;
+			e.nOffset = p.nOffset;
+			e.nStoredSize = p.nStoredSize;
+			e.nFlags = p.nFlags;
+			vFiles.push_back(e);
 		}
 
-		// Don't close base file! we will provide a stream
-		// pointer when the file is requested
+		nVersion = 2;
+		return true;
+	}
+
+	bool ResourcePack::MapFile(const std::string& sFile)
+	{
+#if defined(OLC_RESOURCEPACK_MMAP_POSIX)
+		int fd = open(sFile.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size <= 0) { close(fd); return false; }
+
+		void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // The mapping keeps its own reference to the file
+		if (p == MAP_FAILED) return false;
+
+		pMapped = (const char*)p;
+		nMappedSize = size_t(st.st_size);
+		return true;
+#elif defined(OLC_RESOURCEPACK_MMAP_WINAPI)
+		hMappedFile = CreateFileA(sFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (hMappedFile == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(hMappedFile, &size) || size.QuadPart <= 0) { UnmapFile(); return false; }
+
+		hMapping = CreateFileMappingA(hMappedFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (hMapping == nullptr) { UnmapFile(); return false; }
+
+		pMapped = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (pMapped == nullptr) { UnmapFile(); return false; }
+
+		nMappedSize = size_t(size.QuadPart);
 		return true;
+#else
+		UNUSED(sFile);
+		return false;
+#endif
+	}
+
+	void ResourcePack::UnmapFile()
+	{
+#if defined(OLC_RESOURCEPACK_MMAP_POSIX)
+		if (pMapped) munmap((void*)pMapped, nMappedSize);
+#elif defined(OLC_RESOURCEPACK_MMAP_WINAPI)
+		if (pMapped) UnmapViewOfFile(pMapped);
+		if (hMapping) CloseHandle(hMapping);
+		if (hMappedFile != INVALID_HANDLE_VALUE) CloseHandle(hMappedFile);
+		hMapping = nullptr;
+		hMappedFile = INVALID_HANDLE_VALUE;
+#endif
+		pMapped = nullptr;
+		nMappedSize = 0;
 	}
 
-	bool ResourcePack::SavePack(const std::string& sFile, const std::string& sKey)
+	bool ResourcePack::SavePack(const std::string& sFile, const std::string& sKey, bool bCompress)
 	{
+		static_assert(sizeof(sPackHeader) == 32 && sizeof(sPackEntry) == 48, "Pack structures must not be padded");
+
 		// Create/Overwrite the resource file
 		std::ofstream ofs(sFile, std::ofstream::binary);
 		if (!ofs.is_open()) return false;
 
-		// Iterate through map
-		uint32_t nIndexSize = 0; // Unknown for now
-		ofs.write((char*)&nIndexSize, sizeof(uint32_t));
-		uint32_t nMapSize = uint32_t(mapFiles.size());
-		ofs.write((char*)&nMapSize, sizeof(uint32_t));
-		for (auto& e : mapFiles)
-		{
-			// Write the path of the file
-			size_t nPathSize = e.first.size();
-			ofs.write((char*)&nPathSize, sizeof(uint32_t));
-			ofs.write(e.first.c_str(), nPathSize);
+		auto align = [](uint64_t n) { return (n + nPackAlignment - 1) / nPackAlignment * nPackAlignment; };
 
-			// Write the file entry properties
-			ofs.write((char*)&e.second.nSize, sizeof(uint32_t));
-			ofs.write((char*)&e.second.nOffset, sizeof(uint32_t));
-		}
+		// 1) Size of the index is known up front, the data starts after it
+		uint64_t nIndexSize = vFiles.size() * sizeof(sPackEntry);
+		for (auto& e : vFiles) nIndexSize += e.sPath.size();
+		uint64_t offset = align(sizeof(sPackHeader) + nIndexSize);
 
 		// 2) Write the individual Data
-		std::streampos offset = ofs.tellp();
-		nIndexSize = (uint32_t)offset;
-		for (auto& e : mapFiles)
+		const std::vector<char> vPadding(nPackAlignment, 0);
+		for (auto& e : vFiles)
 		{
-			// Store beginning of file offset within resource pack file
-			e.second.nOffset = (uint32_t)offset;
-
 			// Load the file to be added
-			std::vector<uint8_t> vBuffer(e.second.nSize);
-			std::ifstream i(e.first, std::ifstream::binary);
-			i.read((char*)vBuffer.data(), e.second.nSize);
+			std::vector<char> vBuffer(size_t(e.nSize));
+			std::ifstream i(e.sPath, std::ifstream::binary);
+			i.read(vBuffer.data(), vBuffer.size());
 			i.close();
 
+			// Only keep the compressed version if it's worth decompressing later
+			std::vector<char> vStored;
+			e.nFlags = 0;
+			if (bCompress)
+			{
+				vStored = compress(vBuffer.data(), vBuffer.size());
+				if (vStored.size() < vBuffer.size() - vBuffer.size() / 16) e.nFlags |= nFlagCompressed;
+			}
+			const std::vector<char>& vData = (e.nFlags & nFlagCompressed) ? vStored : vBuffer;
+
+			// Pad up to the entry's aligned offset
+			uint64_t nCursor = uint64_t(ofs.tellp());
+			while (nCursor < offset)
+			{
+				size_t n = size_t(std::min<uint64_t>(offset - nCursor, vPadding.size()));
+				ofs.write(vPadding.data(), n);
+				nCursor += n;
+			}
+
 			// Write the loaded file into resource pack file
-			ofs.write((char*)vBuffer.data(), e.second.nSize);
-			offset += e.second.nSize;
+			e.nOffset = offset;
+			e.nStoredSize = vData.size();
+			ofs.write(vData.data(), vData.size());
+			offset = align(offset + e.nStoredSize);
 		}
 
 		// 3) Scramble Index
 		std::vector<char> stream;
-		auto write = [&stream](const char* data, size_t size) {
+		auto write = [&stream](const void* data, size_t size) {
 			size_t sizeNow = stream.size();
 			stream.resize(sizeNow + size);
 			memcpy(stream.data() + sizeNow, data, size);
 		};
 
-		// Iterate through map
-		write((char*)&nMapSize, sizeof(uint32_t));
-		for (auto& e : mapFiles)
+		uint32_t nPathOffset = 0;
+		for (auto& e : vFiles)
 		{
-			// Write the path of the file
-			size_t nPathSize = e.first.size();
-			write((char*)&nPathSize, sizeof(uint32_t));
-			write(e.first.c_str(), nPathSize);
-
-			// Write the file entry properties
-			write((char*)&e.second.nSize, sizeof(uint32_t));
-			write((char*)&e.second.nOffset, sizeof(uint32_t));
+			sPackEntry p;
+			p.nHash = e.nHash;
+			p.nOffset = e.nOffset;
+			p.nSize = e.nSize;
+			p.nStoredSize = e.nStoredSize;
+			p.nPathOffset = nPathOffset;
+			p.nPathSize = uint32_t(e.sPath.size());
+			p.nFlags = e.nFlags;
+			p.nReserved = 0;
+			write(&p, sizeof(sPackEntry));
+			nPathOffset += p.nPathSize;
 		}
+		for (auto& e : vFiles) write(e.sPath.data(), e.sPath.size());
 		std::vector<char> sIndexString = scramble(stream, sKey);
-		uint32_t nIndexStringLen = uint32_t(sIndexString.size());
-		// 4) Rewrite Map (it has been updated with offsets now)
+
+		// 4) Write header and index (it has been updated with offsets now)
 		// at start of file
+		sPackHeader header;
+		memcpy(header.sMagic, "OLCR", 4);
+		header.nVersion = nPackVersionLatest;
+		header.nAlignment = nPackAlignment;
+		header.nEntries = uint32_t(vFiles.size());
+		header.nIndexOffset = sizeof(sPackHeader);
+		header.nIndexSize = sIndexString.size();
+
 		ofs.seekp(0, std::ios::beg);
-		ofs.write((char*)&nIndexStringLen, sizeof(uint32_t));
-		ofs.write(sIndexString.data(), nIndexStringLen);
+		ofs.write((char*)&header, sizeof(sPackHeader));
+		ofs.write(sIndexString.data(), sIndexString.size());
 		ofs.close();
 		return true;
 	}
 
 	ResourceBuffer ResourcePack::GetFileBuffer(const std::string& sFile)
 	{
-		return ResourceBuffer(baseFile, mapFiles[sFile].nOffset, mapFiles[sFile].nSize);
+		const sResourceFile* e = FindFile(sFile);
+		if (e == nullptr) return ResourceBuffer(nullptr, 0);
+
+		if (e->nFlags & nFlagCompressed)
+		{
+			std::vector<char> vStored;
+			const char* pStored = pMapped ? pMapped + e->nOffset : nullptr;
+			if (pStored == nullptr)
+			{
+				vStored.resize(size_t(e->nStoredSize));
+				if (!ReadBytes(e->nOffset, vStored.data(), vStored.size())) return ResourceBuffer(nullptr, 0);
+				pStored = vStored.data();
+			}
+
+			std::vector<char> vData(size_t(e->nSize));
+			if (!decompress(pStored, size_t(e->nStoredSize), vData.data(), vData.size())) return ResourceBuffer(nullptr, 0);
+			return ResourceBuffer(std::move(vData));
+		}
+
+		// Zero copy, the buffer points into the mapping
+		if (pMapped) return ResourceBuffer(pMapped + e->nOffset, e->nSize);
+
+		return ResourceBuffer(baseFile, e->nOffset, e->nSize);
 	}
 
 	bool ResourcePack::Loaded()
 	{
-		return baseFile.is_open();
+		return baseFile.is_open() || pMapped != nullptr;
+	}
+
+	bool ResourcePack::Mapped()
+	{
+		return pMapped != nullptr;
+	}
+
+	uint32_t ResourcePack::Version()
+	{
+		return nVersion;
+	}
+
+	const ResourcePack::sResourceFile* ResourcePack::FindFile(const std::string& sFile)
+	{
+		const uint64_t h = hash(sFile);
+		auto it = std::lower_bound(vFiles.begin(), vFiles.end(), h, [](const sResourceFile& e, uint64_t value) { return e.nHash < value; });
+		for (; it != vFiles.end() && it->nHash == h; ++it)
+			if (it->sPath == sFile) return &(*it);
+		return nullptr;
+	}
+
+	uint64_t ResourcePack::hash(const std::string& s)
+	{
+		// 64 bit FNV-1a
+		uint64_t h = 14695981039346656037ull;
+		for (auto c : s) h = (h ^ uint8_t(c)) * 1099511628211ull;
+		return h;
+	}
+
+	std::vector<char> ResourcePack::compress(const char* src, size_t nSize)
+	{
+		// Greedy LZ4 block compressor, one candidate per hash slot
+		// Format rules: the last 5 bytes are always literals and the last match starts at least 12 bytes before the end
+		const size_t nMinMatch = 4, nLastLiterals = 5, nMatchLimit = 12;
+		const uint8_t* in = (const uint8_t*)src;
+
+		std::vector<char> out;
+		out.reserve(nSize + nSize / 255 + 16);
+		auto writeLength = [&out](size_t len) {
+			for (; len >= 255; len -= 255) out.push_back(char(255));
+			out.push_back(char(len));
+		};
+		auto emit = [&](size_t nLiteralStart, size_t nLiterals, size_t nOffset, size_t nMatch) {
+			out.push_back(char((std::min<size_t>(nLiterals, 15) << 4) | (nMatch ? std::min<size_t>(nMatch - nMinMatch, 15) : 0)));
+			if (nLiterals >= 15) writeLength(nLiterals - 15);
+			out.insert(out.end(), src + nLiteralStart, src + nLiteralStart + nLiterals);
+			if (nMatch == 0) return;
+			out.push_back(char(nOffset & 0xFF));
+			out.push_back(char(nOffset >> 8));
+			if (nMatch - nMinMatch >= 15) writeLength(nMatch - nMinMatch - 15);
+		};
+
+		size_t anchor = 0;
+		if (nSize > nMatchLimit && nSize < 0xFFFFFFFF)
+		{
+			std::vector<uint32_t> table(1 << 14, 0); // Position + 1, 0 is empty
+			auto slot = [in](size_t p) { uint32_t v; memcpy(&v, in + p, 4); return (v * 2654435761u) >> 18; };
+
+			size_t ip = 0;
+			while (ip < nSize - nMatchLimit)
+			{
+				uint32_t& entry = table[slot(ip)];
+				size_t ref = size_t(entry) - 1;
+				bool bMatch = entry != 0 && ip - ref <= 0xFFFF && memcmp(in + ref, in + ip, nMinMatch) == 0;
+				entry = uint32_t(ip + 1);
+				if (!bMatch) { ip++; continue; }
+
+				size_t len = nMinMatch;
+				const size_t nMaxLen = nSize - nLastLiterals - ip;
+				while (len < nMaxLen && in[ref + len] == in[ip + len]) len++;
+
+				emit(anchor, ip - anchor, ip - ref, len);
+				ip += len;
+				anchor = ip;
+			}
+		}
+
+		// Whatever is left goes out as literals
+		emit(anchor, nSize - anchor, 0, 0);
+		return out;
+	}
+
+	bool ResourcePack::decompress(const char* src, size_t nSrcSize, char* dst, size_t nDstSize)
+	{
+		const uint8_t* ip = (const uint8_t*)src;
+		const uint8_t* const iend = ip + nSrcSize;
+		uint8_t* op = (uint8_t*)dst;
+		uint8_t* const oend = op + nDstSize;
+
+		auto readLength = [&](size_t& len) {
+			uint8_t b;
+			do { if (ip >= iend) return false; b = *ip++; len += b; } while (b == 255);
+			return true;
+		};
+
+		while (ip < iend)
+		{
+			const uint8_t token = *ip++;
+
+			size_t nLiterals = token >> 4;
+			if (nLiterals == 15 && !readLength(nLiterals)) return false;
+			if (nLiterals > size_t(iend - ip) || nLiterals > size_t(oend - op)) return false;
+			memcpy(op, ip, nLiterals);
+			op += nLiterals; ip += nLiterals;
+
+			// The last sequence has no match
+			if (ip == iend) break;
+
+			if (iend - ip < 2) return false;
+			size_t nOffset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+			ip += 2;
+			if (nOffset == 0 || nOffset > size_t(op - (uint8_t*)dst)) return false;
+
+			size_t nMatch = token & 15;
+			if (nMatch == 15 && !readLength(nMatch)) return false;
+			nMatch += 4;
+			if (nMatch > size_t(oend - op)) return false;
+
+			// Matches may overlap what they are writing, so go byte by byte
+			const uint8_t* ref = op - nOffset;
+			for (size_t i = 0; i < nMatch; i++) op[i] = ref[i];
+			op += nMatch;
+		}
+
+		return op == oend;
 	}
 
 	std::vector<char> ResourcePack::scramble(const std::vector<char>& data, const std::string& key)
@@ -1709,6 +2356,12 @@ namespace olc
 			delete layer.pDrawTarget; // Erase existing layer sprites
 			layer.pDrawTarget = new Sprite(vScreenSize.x, vScreenSize.y);
 			layer.bUpdate = true;
+			layer.vDirty.clear();
+			layer.vDrawn.clear();
+			layer.bCleared = false;
+			layer.vRaster.clear();
+			layer.vRasterSprites.clear();
+			layer.vRasterPixels.clear();
 		}
 		SetDrawTarget(nullptr);
 
@@ -1748,10 +2401,16 @@ namespace olc
 		if (target)
 		{
 			pDrawTarget = target;
+
+			// Still track changes if the sprite is one of the layers
+			nDirtyLayer = -1;
+			for (size_t i = 0; i < vLayers.size(); i++)
+				if (vLayers[i].pDrawTarget == target) nDirtyLayer = int32_t(i);
 		}
 		else
 		{
 			nTargetLayer = 0;
+			nDirtyLayer = 0;
 			pDrawTarget = vLayers[0].pDrawTarget;
 		}
 	}
@@ -1761,8 +2420,8 @@ namespace olc
 		if (layer < vLayers.size())
 		{
 			pDrawTarget = vLayers[layer].pDrawTarget;
-			vLayers[layer].bUpdate = true;
 			nTargetLayer = layer;
+			nDirtyLayer = layer;
 		}
 	}
 
@@ -1801,6 +2460,11 @@ namespace olc
 		if (layer < vLayers.size()) vLayers[layer].funcHook = f;
 	}
 
+	void PixelGameEngine::SetLayerSortDecals(uint8_t layer, bool bSort)
+	{
+		if (layer < vLayers.size()) vLayers[layer].bSortDecals = bSort;
+	}
+
 	std::vector<LayerDesc>& PixelGameEngine::GetLayers()
 	{
 		return vLayers;
@@ -1812,7 +2476,7 @@ namespace olc
 		ld.pDrawTarget = new olc::Sprite(vScreenSize.x, vScreenSize.y);
 		ld.nResID = renderer->CreateTexture(vScreenSize.x, vScreenSize.y);
 		renderer->UpdateTexture(ld.nResID, ld.pDrawTarget);
-		vLayers.push_back(ld);
+		vLayers.push_back(std::move(ld));
 		return uint32_t(vLayers.size()) - 1;
 	}
 
@@ -1907,6 +2571,31 @@ namespace olc
 		return vScreenPixelSize;
 	}
 
+	void PixelGameEngine::SetFixedTimeStep(float fStep)
+	{
+		fFixedTimeStep = fStep;
+	}
+
+	void PixelGameEngine::SetFrameLimit(uint32_t nFrames)
+	{
+		nFrameLimit = nFrames;
+	}
+
+	uint32_t PixelGameEngine::GetFrameCount() const
+	{
+		return nTotalFrames;
+	}
+
+	const olc::FrameTimings& PixelGameEngine::GetFrameTimings() const
+	{
+		return sFrameTimings;
+	}
+
+	const olc::RenderStats& PixelGameEngine::GetRenderStats() const
+	{
+		return sRenderStats;
+	}
+
 	const olc::vi2d& PixelGameEngine::GetWindowMouse() const
 	{
 		return vMouseWindowPos;
@@ -1922,6 +2611,24 @@ namespace olc
 	bool PixelGameEngine::Draw(int32_t x, int32_t y, Pixel p)
 	{
 		if (!pDrawTarget) return false;
+		if (nDirtyLayer >= 0)
+		{
+			olc_MarkDirty(x, y, x + 1, y + 1);
+
+			LayerDesc& layer = vLayers[nDirtyLayer];
+			if (layer.bDeferred)
+			{
+				// The custom function may not be safe to call from other threads, so catch up and draw it now
+				if (nPixelMode == Pixel::CUSTOM)
+					olc_FlushLayer(layer);
+				else
+				{
+					if (x < 0 || y < 0 || x >= pDrawTarget->width || y >= pDrawTarget->height) return false;
+					layer.vRaster.push_back({ RasterCommand::PIXEL, uint8_t(nPixelMode), fBlendFactor, p, { x, y }, { x + 1, y + 1 } });
+					return nPixelMode != Pixel::MASK || p.a == 255;
+				}
+			}
+		}
 
 		if (nPixelMode == Pixel::NORMAL)
 		{
@@ -2097,8 +2804,7 @@ namespace olc
 
 			auto drawline = [&](int sx, int ex, int y)
 			{
-				for (int x = sx; x <= ex; x++)
-					Draw(x, y, p);
+				FillRect(sx, y, ex - sx + 1, 1, p);
 			};
 
 			while (y0 >= x0)
@@ -2140,7 +2846,44 @@ namespace olc
 	{
 		int pixels = GetDrawTargetWidth() * GetDrawTargetHeight();
 		Pixel* m = GetDrawTarget()->GetData();
-		for (int i = 0; i < pixels; i++) m[i] = p;
+
+		if (nDirtyLayer >= 0)
+		{
+			LayerDesc& layer = vLayers[nDirtyLayer];
+			// Direct writes (bUpdate) aren't in vDrawn, so they need the full clear
+			if (layer.bCleared && layer.pClear == p && !layer.bUpdate)
+			{
+				// Only what has been drawn since the last clear needs wiping (and uploading)
+				for (const DirtyRect& r : layer.vDrawn)
+				{
+					if (layer.bDeferred)
+						layer.vRaster.push_back({ RasterCommand::FILL, uint8_t(Pixel::NORMAL), 1.0f, p, r.tl, r.br });
+					else
+						for (int32_t y = r.tl.y; y < r.br.y; y++)
+							std::fill(m + y * pDrawTarget->width + r.tl.x, m + y * pDrawTarget->width + r.br.x, p);
+					olc_AddDirtyRect(layer.vDirty, r);
+				}
+				layer.vDrawn.clear();
+				return;
+			}
+
+			olc_AddDirtyRect(layer.vDirty, { { 0, 0 }, { pDrawTarget->width, pDrawTarget->height } });
+			layer.vDrawn.clear();
+			layer.bCleared = true;
+			layer.pClear = p;
+
+			// Everything still pending would be painted over anyway
+			if (layer.bDeferred)
+			{
+				layer.vRaster.clear();
+				layer.vRasterSprites.clear();
+				layer.vRasterPixels.clear();
+				layer.vRaster.push_back({ RasterCommand::FILL, uint8_t(Pixel::NORMAL), 1.0f, p, { 0, 0 }, { pDrawTarget->width, pDrawTarget->height } });
+				return;
+			}
+		}
+
+		std::fill(m, m + pixels, p);
 	}
 
 	void PixelGameEngine::ClearBuffer(Pixel p, bool bDepth)
@@ -2173,6 +2916,21 @@ namespace olc
 		if (y2 < 0) y2 = 0;
 		if (y2 >= (int32_t)GetDrawTargetHeight()) y2 = (int32_t)GetDrawTargetHeight();
 
+		// Whole rows at a time unless every pixel has to go through the custom function
+		if (pDrawTarget && nPixelMode != Pixel::CUSTOM)
+		{
+			if (x2 <= x || y2 <= y) return;
+			olc_MarkDirty(x, y, x2, y2);
+			if (nDirtyLayer >= 0 && vLayers[nDirtyLayer].bDeferred)
+			{
+				vLayers[nDirtyLayer].vRaster.push_back({ RasterCommand::FILL, uint8_t(nPixelMode), fBlendFactor, p, { x, y }, { x2, y2 } });
+				return;
+			}
+			for (int j = y; j < y2; j++)
+				olc_FillSpan(pDrawTarget->GetData() + j * pDrawTarget->width + x, p, x2 - x, nPixelMode, fBlendFactor);
+			return;
+		}
+
 		for (int i = x; i < x2; i++)
 			for (int j = y; j < y2; j++)
 				Draw(i, j, p);
@@ -2198,7 +2956,7 @@ namespace olc
 	// https://www.avrfreaks.net/sites/default/files/triangles.c
 	void PixelGameEngine::FillTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p)
 	{
-		auto drawline = [&](int sx, int ex, int ny) { for (int i = sx; i <= ex; i++) Draw(i, ny, p); };
+		auto drawline = [&](int sx, int ex, int ny) { FillRect(sx, ny, ex - sx + 1, 1, p); };
 
 		int t1x, t2x, y, minx, maxx, t1xp, t2xp;
 		bool changed1 = false;
@@ -2342,6 +3100,9 @@ namespace olc
 		if (sprite == nullptr)
 			return;
 
+		if (olc_DrawSpriteSpans(x, y, sprite, 0, 0, sprite->width, sprite->height, scale, flip))
+			return;
+
 		int32_t fxs = 0, fxm = 1, fx = 0;
 		int32_t fys = 0, fym = 1, fy = 0;
 		if (flip & olc::Sprite::Flip::HORIZ) { fxs = sprite->width - 1; fxm = -1; }
@@ -2376,43 +3137,627 @@ namespace olc
 		DrawPartialSprite(pos.x, pos.y, sprite, sourcepos.x, sourcepos.y, size.x, size.y, scale, flip);
 	}
 
-	void PixelGameEngine::DrawPartialSprite(int32_t x, int32_t y, Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip)
+	void PixelGameEngine::DrawPartialSprite(int32_t x, int32_t y, Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip)
+	{
+		if (sprite == nullptr)
+			return;
+
+		if (olc_DrawSpriteSpans(x, y, sprite, ox, oy, w, h, scale, flip))
+			return;
+
+		int32_t fxs = 0, fxm = 1, fx = 0;
+		int32_t fys = 0, fym = 1, fy = 0;
+		if (flip & olc::Sprite::Flip::HORIZ) { fxs = w - 1; fxm = -1; }
+		if (flip & olc::Sprite::Flip::VERT) { fys = h - 1; fym = -1; }
+
+		if (scale > 1)
+		{
+			fx = fxs;
+			for (int32_t i = 0; i < w; i++, fx += fxm)
+			{
+				fy = fys;
+				for (int32_t j = 0; j < h; j++, fy += fym)
+					for (uint32_t is = 0; is < scale; is++)
+						for (uint32_t js = 0; js < scale; js++)
+							Draw(x + (i * scale) + is, y + (j * scale) + js, sprite->GetPixel(fx + ox, fy + oy));
+			}
+		}
+		else
+		{
+			fx = fxs;
+			for (int32_t i = 0; i < w; i++, fx += fxm)
+			{
+				fy = fys;
+				for (int32_t j = 0; j < h; j++, fy += fym)
+					Draw(x + i, y + j, sprite->GetPixel(fx + ox, fy + oy));
+			}
+		}
+	}
+
+	void PixelGameEngine::SetLayerDeferred(uint8_t layer, bool bDeferred)
+	{
+		if (layer >= vLayers.size()) return;
+
+		// With a single core recording the draws is pure overhead, so they stay immediate
+		if (bDeferred && OLC_RASTER_WORKERS < 2) return;
+
+		if (!bDeferred) olc_FlushLayer(vLayers[layer]);
+		vLayers[layer].bDeferred = bDeferred;
+
+		if (bDeferred && !pRasterPool)
+		{
+			pRasterPool = std::make_unique<WorkerPool>(std::max(1u, uint32_t(OLC_RASTER_WORKERS)));
+			vRasterRows.resize(pRasterPool->Workers());
+		}
+	}
+
+	void PixelGameEngine::olc_FlushSource(const Sprite* sprite)
+	{
+		for (auto& layer : vLayers)
+			if (layer.pDrawTarget == sprite) olc_FlushLayer(layer);
+	}
+
+	void PixelGameEngine::olc_FlushLayer(LayerDesc& layer)
+	{
+		if (layer.vRaster.empty()) return;
+
+		const Sprite* target = layer.pDrawTarget;
+		const int32_t nTilesX = (target->width + nRasterTile - 1) / nRasterTile;
+		const int32_t nTilesY = (target->height + nRasterTile - 1) / nRasterTile;
+
+		// Bin every command into the tiles it touches, each tile then replays its
+		// commands in order so every pixel sees exactly what it would have immediately
+		if (vRasterBins.size() < size_t(nTilesX * nTilesY)) vRasterBins.resize(nTilesX * nTilesY);
+		for (auto& bin : vRasterBins) bin.clear();
+		for (uint32_t i = 0; i < layer.vRaster.size(); i++)
+		{
+			const RasterCommand& c = layer.vRaster[i];
+			for (int32_t ty = c.tl.y / nRasterTile; ty <= (c.br.y - 1) / nRasterTile; ty++)
+				for (int32_t tx = c.tl.x / nRasterTile; tx <= (c.br.x - 1) / nRasterTile; tx++)
+					vRasterBins[ty * nTilesX + tx].push_back(i);
+		}
+
+		vRasterTiles.clear();
+		for (int32_t i = 0; i < nTilesX * nTilesY; i++)
+			if (!vRasterBins[i].empty()) vRasterTiles.push_back(uint32_t(i));
+
+		auto DrawTile = [&](uint32_t nJob, uint32_t nWorker)
+		{
+			const int32_t t = int32_t(vRasterTiles[nJob]);
+			const olc::vi2d tileTL = { (t % nTilesX) * nRasterTile, (t / nTilesX) * nRasterTile };
+			const olc::vi2d tileBR = (tileTL + olc::vi2d(nRasterTile, nRasterTile)).min({ target->width, target->height });
+			for (uint32_t i : vRasterBins[t])
+				olc_Rasterize(layer, layer.vRaster[i], tileTL, tileBR, vRasterRows[nWorker]);
+		};
+
+		// Waking the pool for a handful of pixels isn't worth it
+		if (pRasterPool && vRasterTiles.size() > 1 && layer.vRaster.size() >= 64)
+			pRasterPool->Run(uint32_t(vRasterTiles.size()), DrawTile);
+		else
+		{
+			if (vRasterRows.empty()) vRasterRows.resize(1);
+			for (uint32_t i = 0; i < vRasterTiles.size(); i++) DrawTile(i, 0);
+		}
+
+		layer.vRaster.clear();
+		layer.vRasterSprites.clear();
+		layer.vRasterPixels.clear();
+	}
+
+	void PixelGameEngine::olc_Rasterize(const LayerDesc& layer, const RasterCommand& c, const olc::vi2d& tileTL, const olc::vi2d& tileBR, std::vector<olc::Pixel>& vRow)
+	{
+		const olc::vi2d tl = c.tl.max(tileTL), br = c.br.min(tileBR);
+		if (tl.x >= br.x || tl.y >= br.y) return;
+
+		Sprite* target = layer.pDrawTarget;
+		const Pixel::Mode mode = Pixel::Mode(c.nMode);
+		switch (c.nType)
+		{
+		case RasterCommand::PIXEL:
+			olc_BlendSpan(target->GetData() + tl.y * target->width + tl.x, &c.p, 1, mode, c.fBlend);
+			break;
+
+		case RasterCommand::FILL:
+			for (int32_t y = tl.y; y < br.y; y++)
+				olc_FillSpan(target->GetData() + y * target->width + tl.x, c.p, br.x - tl.x, mode, c.fBlend);
+			break;
+
+		case RasterCommand::SPRITE:
+		{
+			const RasterSprite& s = layer.vRasterSprites[c.nSprite];
+			olc_BlitSprite(target, tl, br, s.pos.x, s.pos.y, layer.vRasterPixels.data() + s.nPixels, s.size.x, s.size.x, s.size.y, s.nScale, s.nFlip, mode, c.fBlend, vRow);
+			break;
+		}
+		}
+	}
+
+	WorkerPool::WorkerPool(uint32_t nWorkers) : nWorkers(std::max(1u, nWorkers))
+	{
+		pQueues.reset(new Queue[this->nWorkers]);
+		for (uint32_t i = 1; i < this->nWorkers; i++)
+			vThreads.emplace_back(&WorkerPool::Worker, this, i);
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mux);
+			bQuit = true;
+		}
+		cvStart.notify_all();
+		for (auto& t : vThreads) t.join();
+	}
+
+	uint32_t WorkerPool::Workers() const
+	{
+		return nWorkers;
+	}
+
+	void WorkerPool::Run(uint32_t nJobs, const std::function<void(uint32_t, uint32_t)>& job)
+	{
+		if (nJobs == 0) return;
+
+		for (uint32_t i = 0; i < nJobs; i++)
+		{
+			Queue& q = pQueues[i % nWorkers];
+			std::lock_guard<std::mutex> lock(q.mux);
+			q.jobs.push_back(i);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mux);
+			pJob = &job;
+			nBusy = uint32_t(vThreads.size());
+			nGeneration++;
+		}
+		cvStart.notify_all();
+
+		// This thread is worker 0
+		Work(0);
+
+		// The job has to outlive every thread that might still be looking at it
+		std::unique_lock<std::mutex> lock(mux);
+		cvDone.wait(lock, [&] { return nBusy == 0; });
+		pJob = nullptr;
+	}
+
+	void WorkerPool::Worker(uint32_t nWorker)
+	{
+		uint64_t nSeen = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mux);
+				cvStart.wait(lock, [&] { return bQuit || nGeneration != nSeen; });
+				if (bQuit) return;
+				nSeen = nGeneration;
+			}
+
+			Work(nWorker);
+
+			std::lock_guard<std::mutex> lock(mux);
+			if (--nBusy == 0) cvDone.notify_all();
+		}
+	}
+
+	void WorkerPool::Work(uint32_t nWorker)
+	{
+		uint32_t nJob = 0;
+		while (Take(nWorker, nJob))
+			(*pJob)(nJob, nWorker);
+	}
+
+	bool WorkerPool::Take(uint32_t nWorker, uint32_t& nJob)
+	{
+		// Own jobs from the front
+		{
+			Queue& q = pQueues[nWorker];
+			std::lock_guard<std::mutex> lock(q.mux);
+			if (!q.jobs.empty())
+			{
+				nJob = q.jobs.front();
+				q.jobs.pop_front();
+				return true;
+			}
+		}
+
+		// Someone else's from the back
+		for (uint32_t i = 1; i < nWorkers; i++)
+		{
+			Queue& q = pQueues[(nWorker + i) % nWorkers];
+			std::lock_guard<std::mutex> lock(q.mux);
+			if (!q.jobs.empty())
+			{
+				nJob = q.jobs.back();
+				q.jobs.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void PixelGameEngine::olc_MarkDirty(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+	{
+		if (nDirtyLayer < 0 || pDrawTarget == nullptr) return;
+
+		x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+		x1 = std::min(x1, pDrawTarget->width); y1 = std::min(y1, pDrawTarget->height);
+		if (x0 >= x1 || y0 >= y1) return;
+
+		LayerDesc& layer = vLayers[nDirtyLayer];
+		olc_AddDirtyRect(layer.vDirty, { { x0, y0 }, { x1, y1 } });
+		if (layer.bCleared) olc_AddDirtyRect(layer.vDrawn, { { x0, y0 }, { x1, y1 } });
+	}
+
+	void PixelGameEngine::olc_AddDirtyRect(std::vector<DirtyRect>& vRects, const DirtyRect& r)
+	{
+		// Most drawing arrives in runs of neighbouring pixels, so grow the last
+		// rect while that wastes little, and start a new one when it doesn't
+		if (!vRects.empty())
+		{
+			DirtyRect& last = vRects.back();
+			DirtyRect u = { last.tl.min(r.tl), last.br.max(r.br) };
+			if (u.area() <= last.area() + r.area() + 64)
+			{
+				last = u;
+				return;
+			}
+		}
+
+		// Too many small pieces, keep their bounds instead
+		if (vRects.size() >= 32)
+		{
+			DirtyRect& b = vRects[0];
+			for (const DirtyRect& d : vRects)
+			{
+				b.tl = b.tl.min(d.tl);
+				b.br = b.br.max(d.br);
+			}
+			b.tl = b.tl.min(r.tl);
+			b.br = b.br.max(r.br);
+			vRects.resize(1);
+			return;
+		}
+
+		vRects.push_back(r);
+	}
+
+	void PixelGameEngine::olc_UploadLayer(LayerDesc& layer, RenderStats& stats)
+	{
+		olc::Sprite* spr = layer.pDrawTarget;
+		const int32_t nLayerArea = spr->width * spr->height;
+
+		// Someone wrote to the sprite behind our back, what we know about its contents can't be trusted
+		if (layer.bUpdate) layer.bCleared = false;
+
+		int64_t nDirtyArea = 0;
+		for (const DirtyRect& r : layer.vDirty) nDirtyArea += r.area();
+
+		// Once half the layer has changed one big upload beats lots of small ones
+		if (layer.bUpdate || nDirtyArea * 2 >= nLayerArea)
+		{
+			renderer->UpdateTexture(layer.nResID, spr);
+			stats.nTextureUploads++;
+			stats.nUploadedPixels += nLayerArea;
+		}
+		else
+		{
+			for (const DirtyRect& r : layer.vDirty)
+			{
+				renderer->UpdateTextureRegion(layer.nResID, spr, r.tl, r.br - r.tl);
+				stats.nTextureUploads++;
+				stats.nUploadedPixels += r.area();
+			}
+		}
+
+		layer.bUpdate = false;
+		layer.vDirty.clear();
+	}
+
+	bool PixelGameEngine::olc_DrawSpriteSpans(int32_t x, int32_t y, const Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip)
+	{
+		// Pending draws to the source have to land before it is read
+		olc_FlushSource(sprite);
+
+		// Only when the rows can be read straight out of the sprite, anything that
+		// samples outside of it (blank or wrapped pixels) goes pixel by pixel
+		if (pDrawTarget == nullptr || nPixelMode == Pixel::CUSTOM) return false;
+		if (ox < 0 || oy < 0 || w < 0 || h < 0 || ox + w > sprite->width || oy + h > sprite->height) return false;
+
+		const int64_t s = std::max(scale, 1u);
+
+		// Clip to the draw target
+		int32_t x0 = (int32_t)std::max<int64_t>(x, 0), x1 = (int32_t)std::min<int64_t>(x + w * s, pDrawTarget->width);
+		int32_t y0 = (int32_t)std::max<int64_t>(y, 0), y1 = (int32_t)std::min<int64_t>(y + h * s, pDrawTarget->height);
+		if (x0 >= x1 || y0 >= y1) return true;
+		olc_MarkDirty(x0, y0, x1, y1);
+
+		// A sprite drawn onto itself can't be split into tiles, that one is drawn straight away
+		if (nDirtyLayer >= 0 && vLayers[nDirtyLayer].bDeferred && sprite != pDrawTarget)
+		{
+			// Only the source columns and rows that land inside the clip are kept
+			const int32_t cx0 = int32_t((x0 - x) / s), cx1 = int32_t((x1 - 1 - x) / s);
+			const int32_t cy0 = int32_t((y0 - y) / s), cy1 = int32_t((y1 - 1 - y) / s);
+			const int32_t cw = cx1 - cx0 + 1, ch = cy1 - cy0 + 1;
+			const int32_t sx = ox + ((flip & olc::Sprite::Flip::HORIZ) ? w - 1 - cx1 : cx0);
+			const int32_t sy = oy + ((flip & olc::Sprite::Flip::VERT) ? h - 1 - cy1 : cy0);
+
+			LayerDesc& layer = vLayers[nDirtyLayer];
+			const size_t nPixels = layer.vRasterPixels.size();
+			for (int32_t j = 0; j < ch; j++)
+			{
+				const Pixel* src = sprite->pColData + (sy + j) * sprite->width + sx;
+				layer.vRasterPixels.insert(layer.vRasterPixels.end(), src, src + cw);
+			}
+
+			// Placed so the copy maps onto the same target pixels the whole sprite would have
+			layer.vRaster.push_back({ RasterCommand::SPRITE, uint8_t(nPixelMode), fBlendFactor, olc::BLANK, { x0, y0 }, { x1, y1 }, uint32_t(layer.vRasterSprites.size()) });
+			layer.vRasterSprites.push_back({ nPixels, { int32_t(x + cx0 * s), int32_t(y + cy0 * s) }, { cw, ch }, scale, flip });
+			return true;
+		}
+
+		olc_BlitSprite(pDrawTarget, { x0, y0 }, { x1, y1 }, x, y, sprite->pColData + oy * sprite->width + ox, sprite->width, w, h, scale, flip, nPixelMode, fBlendFactor, vSpanRow);
+		return true;
+	}
+
+	void PixelGameEngine::olc_BlitSprite(Sprite* target, const olc::vi2d& tl, const olc::vi2d& br, int32_t x, int32_t y, const Pixel* pSource, int32_t nStride, int32_t w, int32_t h, uint32_t scale, uint8_t flip, Pixel::Mode mode, float fBlend, std::vector<olc::Pixel>& vRow)
+	{
+		const int64_t s = std::max(scale, 1u);
+		const bool bFlipX = flip & olc::Sprite::Flip::HORIZ, bFlipY = flip & olc::Sprite::Flip::VERT;
+		const int32_t x0 = tl.x, y0 = tl.y, x1 = br.x, y1 = br.y;
+		const int32_t n = x1 - x0;
+
+		// Unscaled and unflipped rows are blended straight from the sprite, otherwise the
+		// visible part of each source row is expanded once and reused for all 'scale' rows
+		const bool bDirect = s == 1 && !bFlipX;
+		if (!bDirect && vRow.size() < size_t(n)) vRow.resize(n);
+
+		Pixel* dst = target->GetData() + y0 * target->width + x0;
+		int32_t nLastRow = -1;
+		for (int32_t j = y0; j < y1; j++, dst += target->width)
+		{
+			int32_t sy = int32_t((j - y) / s);
+			if (bFlipY) sy = h - 1 - sy;
+			const Pixel* src = pSource + sy * nStride;
+
+			if (bDirect)
+			{
+				olc_BlendSpan(dst, src + (x0 - x), n, mode, fBlend);
+				continue;
+			}
+
+			if (sy != nLastRow)
+			{
+				int32_t sx = int32_t((x0 - x) / s), k = int32_t((x0 - x) % s);
+				for (int32_t i = 0; i < n; i++)
+				{
+					vRow[i] = src[bFlipX ? w - 1 - sx : sx];
+					if (++k == s) { k = 0; sx++; }
+				}
+				nLastRow = sy;
+			}
+			olc_BlendSpan(dst, vRow.data(), n, mode, fBlend);
+		}
+	}
+
+	void PixelGameEngine::olc_FillSpan(olc::Pixel* dst, const olc::Pixel p, int32_t n, Pixel::Mode mode, float fBlend)
+	{
+		if (mode == Pixel::NORMAL || (mode == Pixel::MASK && p.a == 255))
+		{
+			std::fill(dst, dst + n, p);
+		}
+		else if (mode == Pixel::ALPHA)
+		{
+			// Blend against a short run of the colour
+			Pixel run[64];
+			std::fill(run, run + 64, p);
+			for (int32_t i = 0; i < n; i += 64)
+				olc_BlendSpan(dst + i, run, std::min(64, n - i), mode, fBlend);
+		}
+	}
+
+	void PixelGameEngine::olc_BlendSpan(olc::Pixel* dst, const olc::Pixel* src, int32_t n, Pixel::Mode mode, float fBlend)
+	{
+		int32_t i = 0;
+
+		if (mode == Pixel::NORMAL)
+		{
+			memmove(dst, src, n * sizeof(Pixel));
+			return;
+		}
+
+		if (mode == Pixel::MASK)
+		{
+#if defined(OLC_SIMD_SSE2)
+			const __m128i vOpaque = _mm_set1_epi32(int(0xFF000000));
+			for (; i + 4 <= n; i += 4)
+			{
+				__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+				__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+				__m128i m = _mm_cmpeq_epi32(_mm_and_si128(s, vOpaque), vOpaque);
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_and_si128(m, s), _mm_andnot_si128(m, d)));
+			}
+#endif
+			for (; i < n; i++)
+				if (src[i].a == 255) dst[i] = src[i];
+			return;
+		}
+
+		if (mode != Pixel::ALPHA) return;
+
+		// Same float maths as Draw(), in the same order, so the results match to the bit.
+		// Fully transparent pixels only make the destination opaque, fully opaque ones
+		// (with no blend factor) replace it, neither needs blending.
+		const bool bNoBlend = fBlend == 1.0f;
+
+#if defined(OLC_SIMD_AVX2)
+		{
+			const __m256 v255 = _mm256_set1_ps(255.0f), vBlend = _mm256_set1_ps(fBlend), vOne = _mm256_set1_ps(1.0f);
+			const __m256i vZero = _mm256_setzero_si256(), vOpaque = _mm256_set1_epi32(int(0xFF000000));
+
+			// One pixel per 128 bit lane, a channel per float
+			auto Blend = [&](__m256i s32, __m256i d32)
+			{
+				__m256 s = _mm256_cvtepi32_ps(s32), d = _mm256_cvtepi32_ps(d32);
+				__m256 a = _mm256_mul_ps(_mm256_div_ps(_mm256_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3)), v255), vBlend);
+				__m256 c = _mm256_sub_ps(vOne, a);
+				return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(a, s), _mm256_mul_ps(c, d)));
+			};
+
+			for (; i + 8 <= n; i += 8)
+			{
+				__m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+				__m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+				__m256i sa = _mm256_and_si256(s, vOpaque);
+
+				if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, vZero)) == -1)
+				{
+					_mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(d, vOpaque));
+					continue;
+				}
+				if (bNoBlend && _mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, vOpaque)) == -1)
+				{
+					_mm256_storeu_si256((__m256i*)(dst + i), s);
+					continue;
+				}
+
+				// Unpacking and packing within lanes cancel out, so the pixels end up back in order
+				__m256i sLo = _mm256_unpacklo_epi8(s, vZero), sHi = _mm256_unpackhi_epi8(s, vZero);
+				__m256i dLo = _mm256_unpacklo_epi8(d, vZero), dHi = _mm256_unpackhi_epi8(d, vZero);
+				__m256i r0 = Blend(_mm256_unpacklo_epi16(sLo, vZero), _mm256_unpacklo_epi16(dLo, vZero));
+				__m256i r1 = Blend(_mm256_unpackhi_epi16(sLo, vZero), _mm256_unpackhi_epi16(dLo, vZero));
+				__m256i r2 = Blend(_mm256_unpacklo_epi16(sHi, vZero), _mm256_unpacklo_epi16(dHi, vZero));
+				__m256i r3 = Blend(_mm256_unpackhi_epi16(sHi, vZero), _mm256_unpackhi_epi16(dHi, vZero));
+				__m256i r = _mm256_packus_epi16(_mm256_packs_epi32(r0, r1), _mm256_packs_epi32(r2, r3));
+				_mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(r, vOpaque));
+			}
+		}
+#endif
+
+#if defined(OLC_SIMD_SSE2)
+		{
+			const __m128 v255 = _mm_set1_ps(255.0f), vBlend = _mm_set1_ps(fBlend), vOne = _mm_set1_ps(1.0f);
+			const __m128i vZero = _mm_setzero_si128(), vOpaque = _mm_set1_epi32(int(0xFF000000));
+
+			// One pixel per register, a channel per float
+			auto Blend = [&](__m128i s32, __m128i d32)
+			{
+				__m128 s = _mm_cvtepi32_ps(s32), d = _mm_cvtepi32_ps(d32);
+				__m128 a = _mm_mul_ps(_mm_div_ps(_mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3)), v255), vBlend);
+				__m128 c = _mm_sub_ps(vOne, a);
+				return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, s), _mm_mul_ps(c, d)));
+			};
+
+			for (; i + 4 <= n; i += 4)
+			{
+				__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+				__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+				__m128i sa = _mm_and_si128(s, vOpaque);
+
+				if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, vZero)) == 0xFFFF)
+				{
+					_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(d, vOpaque));
+					continue;
+				}
+				if (bNoBlend && _mm_movemask_epi8(_mm_cmpeq_epi32(sa, vOpaque)) == 0xFFFF)
+				{
+					_mm_storeu_si128((__m128i*)(dst + i), s);
+					continue;
+				}
+
+				__m128i sLo = _mm_unpacklo_epi8(s, vZero), sHi = _mm_unpackhi_epi8(s, vZero);
+				__m128i dLo = _mm_unpacklo_epi8(d, vZero), dHi = _mm_unpackhi_epi8(d, vZero);
+				__m128i r0 = Blend(_mm_unpacklo_epi16(sLo, vZero), _mm_unpacklo_epi16(dLo, vZero));
+				__m128i r1 = Blend(_mm_unpackhi_epi16(sLo, vZero), _mm_unpackhi_epi16(dLo, vZero));
+				__m128i r2 = Blend(_mm_unpacklo_epi16(sHi, vZero), _mm_unpacklo_epi16(dHi, vZero));
+				__m128i r3 = Blend(_mm_unpackhi_epi16(sHi, vZero), _mm_unpackhi_epi16(dHi, vZero));
+				__m128i r = _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(r, vOpaque));
+			}
+		}
+#endif
+
+		for (; i < n; i++)
+		{
+			const Pixel p = src[i], d = dst[i];
+			if (p.a == 0) { dst[i] = Pixel(d.r, d.g, d.b); continue; }
+			if (bNoBlend && p.a == 255) { dst[i] = p; continue; }
+			float a = (float)(p.a / 255.0f) * fBlend;
+			float c = 1.0f - a;
+			float r = a * (float)p.r + c * (float)d.r;
+			float g = a * (float)p.g + c * (float)d.g;
+			float b = a * (float)p.b + c * (float)d.b;
+			dst[i] = Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b);
+		}
+	}
+
+	void PixelGameEngine::SetDecalMode(const olc::DecalMode& mode)
 	{
-		if (sprite == nullptr)
-			return;
+		nDecalMode = mode;
+	}
 
-		int32_t fxs = 0, fxm = 1, fx = 0;
-		int32_t fys = 0, fym = 1, fy = 0;
-		if (flip & olc::Sprite::Flip::HORIZ) { fxs = w - 1; fxm = -1; }
-		if (flip & olc::Sprite::Flip::VERT) { fys = h - 1; fym = -1; }
+	void* DecalArena::Allocate(size_t nBytes)
+	{
+		// Keep every allocation 16 byte aligned
+		nBytes = (nBytes + 15) & ~size_t(15);
 
-		if (scale > 1)
+		// Move on to the next block that fits, making one if there aren't any left
+		while (nBlock < vBlocks.size() && nUsed + nBytes > vBlocks[nBlock].nSize)
 		{
-			fx = fxs;
-			for (int32_t i = 0; i < w; i++, fx += fxm)
-			{
-				fy = fys;
-				for (int32_t j = 0; j < h; j++, fy += fym)
-					for (uint32_t is = 0; is < scale; is++)
-						for (uint32_t js = 0; js < scale; js++)
-							Draw(x + (i * scale) + is, y + (j * scale) + js, sprite->GetPixel(fx + ox, fy + oy));
-			}
+			nBlock++;
+			nUsed = 0;
 		}
-		else
+		if (nBlock == vBlocks.size())
 		{
-			fx = fxs;
-			for (int32_t i = 0; i < w; i++, fx += fxm)
-			{
-				fy = fys;
-				for (int32_t j = 0; j < h; j++, fy += fym)
-					Draw(x + i, y + j, sprite->GetPixel(fx + ox, fy + oy));
-			}
+			Block b;
+			b.nSize = std::max(nBlockSize, nBytes);
+			b.pData.reset(new uint8_t[b.nSize]);
+			vBlocks.push_back(std::move(b));
+			nAllocations++;
 		}
+
+		void* p = vBlocks[nBlock].pData.get() + nUsed;
+		nUsed += nBytes;
+		return p;
 	}
 
-	void PixelGameEngine::SetDecalMode(const olc::DecalMode& mode)
+	void DecalArena::Reset()
 	{
-		nDecalMode = mode;
+		nBlock = 0;
+		nUsed = 0;
+		nAllocations = 0;
+	}
+
+	uint32_t DecalArena::Allocations() const
+	{
+		return nAllocations;
+	}
+
+	DecalInstance& PixelGameEngine::olc_NewDecalInstance(olc::Decal* decal, uint32_t nPoints)
+	{
+		LayerDesc& layer = vLayers[nTargetLayer];
+		if (layer.vecDecalInstance.size() == layer.vecDecalInstance.capacity()) nDecalAllocations++;
+		layer.vecDecalInstance.emplace_back();
+
+		DecalInstance& di = layer.vecDecalInstance.back();
+		di.decal = decal;
+		di.points = nPoints;
+		di.mode = nDecalMode;
+
+		// Vertex data lives in the layer's arena until the layer has been drawn
+		uint8_t* p = (uint8_t*)layer.decalArena.Allocate(nPoints * (2 * sizeof(olc::vf2d) + sizeof(float) + sizeof(olc::Pixel)));
+		di.pos = (olc::vf2d*)p;		p += nPoints * sizeof(olc::vf2d);
+		di.uv = (olc::vf2d*)p;		p += nPoints * sizeof(olc::vf2d);
+		di.w = (float*)p;			p += nPoints * sizeof(float);
+		di.tint = (olc::Pixel*)p;
+		return di;
+	}
+
+	void PixelGameEngine::olc_SetDecalQuad(DecalInstance& di, const olc::vf2d& tl, const olc::vf2d& br, const olc::vf2d& uvtl, const olc::vf2d& uvbr, const olc::Pixel& tint)
+	{
+		di.pos[0] = { tl.x, tl.y }; di.pos[1] = { tl.x, br.y }; di.pos[2] = { br.x, br.y }; di.pos[3] = { br.x, tl.y };
+		di.uv[0] = { uvtl.x, uvtl.y }; di.uv[1] = { uvtl.x, uvbr.y }; di.uv[2] = { uvbr.x, uvbr.y }; di.uv[3] = { uvbr.x, uvtl.y };
+		for (int i = 0; i < 4; i++) { di.w[i] = 1.0f; di.tint[i] = tint; }
 	}
 
 	void PixelGameEngine::DrawPartialDecal(const olc::vf2d& pos, olc::Decal* decal, const olc::vf2d& source_pos, const olc::vf2d& source_size, const olc::vf2d& scale, const olc::Pixel& tint)
@@ -2429,17 +3774,10 @@ namespace olc
 			vScreenSpacePos.y - (2.0f * source_size.y * vInvScreenSize.y) * scale.y
 		};
 
-		DecalInstance di;
-		di.points = 4;
-		di.decal = decal;
-		di.tint = { tint, tint, tint, tint };
-		di.pos = { { vScreenSpacePos.x, vScreenSpacePos.y }, { vScreenSpacePos.x, vScreenSpaceDim.y }, { vScreenSpaceDim.x, vScreenSpaceDim.y }, { vScreenSpaceDim.x, vScreenSpacePos.y } };
+		DecalInstance& di = olc_NewDecalInstance(decal, 4);
 		olc::vf2d uvtl = source_pos * decal->vUVScale;
 		olc::vf2d uvbr = uvtl + (source_size * decal->vUVScale);
-		di.uv = { { uvtl.x, uvtl.y }, { uvtl.x, uvbr.y }, { uvbr.x, uvbr.y }, { uvbr.x, uvtl.y } };
-		di.w = { 1,1,1,1 };
-		di.mode = nDecalMode;
-		vLayers[nTargetLayer].vecDecalInstance.push_back(di);
+		olc_SetDecalQuad(di, vScreenSpacePos, vScreenSpaceDim, uvtl, uvbr, tint);
 	}
 
 	void PixelGameEngine::DrawPartialDecal(const olc::vf2d& pos, const olc::vf2d& size, olc::Decal* decal, const olc::vf2d& source_pos, const olc::vf2d& source_size, const olc::Pixel& tint)
@@ -2456,17 +3794,10 @@ namespace olc
 			vScreenSpacePos.y - (2.0f * size.y * vInvScreenSize.y)
 		};
 
-		DecalInstance di;
-		di.points = 4;
-		di.decal = decal;
-		di.tint = { tint, tint, tint, tint };
-		di.pos = { { vScreenSpacePos.x, vScreenSpacePos.y }, { vScreenSpacePos.x, vScreenSpaceDim.y }, { vScreenSpaceDim.x, vScreenSpaceDim.y }, { vScreenSpaceDim.x, vScreenSpacePos.y } };
+		DecalInstance& di = olc_NewDecalInstance(decal, 4);
 		olc::vf2d uvtl = (source_pos) * decal->vUVScale;
 		olc::vf2d uvbr = uvtl + ((source_size) * decal->vUVScale);
-		di.uv = { { uvtl.x, uvtl.y }, { uvtl.x, uvbr.y }, { uvbr.x, uvbr.y }, { uvbr.x, uvtl.y } };
-		di.w = { 1,1,1,1 };
-		di.mode = nDecalMode;
-		vLayers[nTargetLayer].vecDecalInstance.push_back(di);
+		olc_SetDecalQuad(di, vScreenSpacePos, vScreenSpaceDim, uvtl, uvbr, tint);
 	}
 
 
@@ -2484,26 +3815,13 @@ namespace olc
 			vScreenSpacePos.y - (2.0f * (float(decal->sprite->height) * vInvScreenSize.y)) * scale.y
 		};
 
-		DecalInstance di;
-		di.decal = decal;
-		di.points = 4;
-		di.tint = { tint, tint, tint, tint };
-		di.pos = { { vScreenSpacePos.x, vScreenSpacePos.y }, { vScreenSpacePos.x, vScreenSpaceDim.y }, { vScreenSpaceDim.x, vScreenSpaceDim.y }, { vScreenSpaceDim.x, vScreenSpacePos.y } };
-		di.uv = { { 0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f} };
-		di.w = { 1, 1, 1, 1 };
-		di.mode = nDecalMode;
-		vLayers[nTargetLayer].vecDecalInstance.push_back(di);
+		DecalInstance& di = olc_NewDecalInstance(decal, 4);
+		olc_SetDecalQuad(di, vScreenSpacePos, vScreenSpaceDim, { 0.0f, 0.0f }, { 1.0f, 1.0f }, tint);
 	}
 
 	void PixelGameEngine::DrawExplicitDecal(olc::Decal* decal, const olc::vf2d* pos, const olc::vf2d* uv, const olc::Pixel* col, uint32_t elements)
 	{
-		DecalInstance di;
-		di.decal = decal;
-		di.pos.resize(elements);
-		di.uv.resize(elements);
-		di.w.resize(elements);
-		di.tint.resize(elements);
-		di.points = elements;
+		DecalInstance& di = olc_NewDecalInstance(decal, elements);
 		for (uint32_t i = 0; i < elements; i++)
 		{
 			di.pos[i] = { (pos[i].x * vInvScreenSize.x) * 2.0f - 1.0f, ((pos[i].y * vInvScreenSize.y) * 2.0f - 1.0f) * -1.0f };
@@ -2511,19 +3829,11 @@ namespace olc
 			di.tint[i] = col[i];
 			di.w[i] = 1.0f;
 		}
-		di.mode = nDecalMode;
-		vLayers[nTargetLayer].vecDecalInstance.push_back(di);
 	}
 
 	void PixelGameEngine::DrawPolygonDecal(olc::Decal* decal, const std::vector<olc::vf2d>& pos, const std::vector<olc::vf2d>& uv, const olc::Pixel tint)
 	{
-		DecalInstance di;
-		di.decal = decal;
-		di.points = uint32_t(pos.size());
-		di.pos.resize(di.points);
-		di.uv.resize(di.points);
-		di.w.resize(di.points);
-		di.tint.resize(di.points);
+		DecalInstance& di = olc_NewDecalInstance(decal, uint32_t(pos.size()));
 		for (uint32_t i = 0; i < di.points; i++)
 		{
 			di.pos[i] = { (pos[i].x * vInvScreenSize.x) * 2.0f - 1.0f, ((pos[i].y * vInvScreenSize.y) * 2.0f - 1.0f) * -1.0f };
@@ -2531,8 +3841,6 @@ namespace olc
 			di.tint[i] = tint;
 			di.w[i] = 1.0f;
 		}
-		di.mode = nDecalMode;
-		vLayers[nTargetLayer].vecDecalInstance.push_back(di);
 	}
 
 	void PixelGameEngine::FillRectDecal(const olc::vf2d& pos, const olc::vf2d& size, const olc::Pixel col)
@@ -2553,13 +3861,8 @@ namespace olc
 
 	void PixelGameEngine::DrawRotatedDecal(const olc::vf2d& pos, olc::Decal* decal, const float fAngle, const olc::vf2d& center, const olc::vf2d& scale, const olc::Pixel& tint)
 	{
-		DecalInstance di;
-		di.decal = decal;
-		di.pos.resize(4);
-		di.uv = { { 0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f} };
-		di.w = { 1, 1, 1, 1 };
-		di.tint = { tint, tint, tint, tint };
-		di.points = 4;
+		DecalInstance& di = olc_NewDecalInstance(decal, 4);
+		olc_SetDecalQuad(di, { 0.0f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f }, { 1.0f, 1.0f }, tint);
 		di.pos[0] = (olc::vf2d(0.0f, 0.0f) - center) * scale;
 		di.pos[1] = (olc::vf2d(0.0f, float(decal->sprite->height)) - center) * scale;
 		di.pos[2] = (olc::vf2d(float(decal->sprite->width), float(decal->sprite->height)) - center) * scale;
@@ -2570,21 +3873,16 @@ namespace olc
 			di.pos[i] = pos + olc::vf2d(di.pos[i].x * c - di.pos[i].y * s, di.pos[i].x * s + di.pos[i].y * c);
 			di.pos[i] = di.pos[i] * vInvScreenSize * 2.0f - olc::vf2d(1.0f, 1.0f);
 			di.pos[i].y *= -1.0f;
-			di.w[i] = 1;
 		}
-		di.mode = nDecalMode;
-		vLayers[nTargetLayer].vecDecalInstance.push_back(di);
 	}
 
 
 	void PixelGameEngine::DrawPartialRotatedDecal(const olc::vf2d& pos, olc::Decal* decal, const float fAngle, const olc::vf2d& center, const olc::vf2d& source_pos, const olc::vf2d& source_size, const olc::vf2d& scale, const olc::Pixel& tint)
 	{
-		DecalInstance di;
-		di.decal = decal;
-		di.points = 4;
-		di.tint = { tint, tint, tint, tint };
-		di.w = { 1, 1, 1, 1 };
-		di.pos.resize(4);
+		DecalInstance& di = olc_NewDecalInstance(decal, 4);
+		olc::vf2d uvtl = source_pos * decal->vUVScale;
+		olc::vf2d uvbr = uvtl + (source_size * decal->vUVScale);
+		olc_SetDecalQuad(di, { 0.0f, 0.0f }, { 0.0f, 0.0f }, uvtl, uvbr, tint);
 		di.pos[0] = (olc::vf2d(0.0f, 0.0f) - center) * scale;
 		di.pos[1] = (olc::vf2d(0.0f, source_size.y) - center) * scale;
 		di.pos[2] = (olc::vf2d(source_size.x, source_size.y) - center) * scale;
@@ -2596,30 +3894,18 @@ namespace olc
 			di.pos[i] = di.pos[i] * vInvScreenSize * 2.0f - olc::vf2d(1.0f, 1.0f);
 			di.pos[i].y *= -1.0f;
 		}
-
-		olc::vf2d uvtl = source_pos * decal->vUVScale;
-		olc::vf2d uvbr = uvtl + (source_size * decal->vUVScale);
-		di.uv = { { uvtl.x, uvtl.y }, { uvtl.x, uvbr.y }, { uvbr.x, uvbr.y }, { uvbr.x, uvtl.y } };
-		di.mode = nDecalMode;
-		vLayers[nTargetLayer].vecDecalInstance.push_back(di);
 	}
 
 	void PixelGameEngine::DrawPartialWarpedDecal(olc::Decal* decal, const olc::vf2d* pos, const olc::vf2d& source_pos, const olc::vf2d& source_size, const olc::Pixel& tint)
 	{
-		DecalInstance di;
-		di.points = 4;
-		di.decal = decal;
-		di.tint = { tint, tint, tint, tint };
-		di.w = { 1, 1, 1, 1 };
-		di.pos.resize(4);
-		di.uv = { { 0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f} };
 		olc::vf2d center;
 		float rd = ((pos[2].x - pos[0].x) * (pos[3].y - pos[1].y) - (pos[3].x - pos[1].x) * (pos[2].y - pos[0].y));
 		if (rd != 0)
 		{
+			DecalInstance& di = olc_NewDecalInstance(decal, 4);
 			olc::vf2d uvtl = source_pos * decal->vUVScale;
 			olc::vf2d uvbr = uvtl + (source_size * decal->vUVScale);
-			di.uv = { { uvtl.x, uvtl.y }, { uvtl.x, uvbr.y }, { uvbr.x, uvbr.y }, { uvbr.x, uvtl.y } };
+			olc_SetDecalQuad(di, { 0.0f, 0.0f }, { 0.0f, 0.0f }, uvtl, uvbr, tint);
 
 			rd = 1.0f / rd;
 			float rn = ((pos[3].x - pos[1].x) * (pos[0].y - pos[1].y) - (pos[3].y - pos[1].y) * (pos[0].x - pos[1].x)) * rd;
@@ -2632,8 +3918,6 @@ namespace olc
 				di.uv[i] *= q; di.w[i] *= q;
 				di.pos[i] = { (pos[i].x * vInvScreenSize.x) * 2.0f - 1.0f, ((pos[i].y * vInvScreenSize.y) * 2.0f - 1.0f) * -1.0f };
 			}
-			di.mode = nDecalMode;
-			vLayers[nTargetLayer].vecDecalInstance.push_back(di);
 		}
 	}
 
@@ -2641,17 +3925,13 @@ namespace olc
 	{
 		// Thanks Nathan Reed, a brilliant article explaining whats going on here
 		// http://www.reedbeta.com/blog/quadrilateral-interpolation-part-1/
-		DecalInstance di;
-		di.points = 4;
-		di.decal = decal;
-		di.tint = { tint, tint, tint, tint };
-		di.w = { 1, 1, 1, 1 };
-		di.pos.resize(4);
-		di.uv = { { 0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f} };
 		olc::vf2d center;
 		float rd = ((pos[2].x - pos[0].x) * (pos[3].y - pos[1].y) - (pos[3].x - pos[1].x) * (pos[2].y - pos[0].y));
 		if (rd != 0)
 		{
+			DecalInstance& di = olc_NewDecalInstance(decal, 4);
+			olc_SetDecalQuad(di, { 0.0f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f }, { 1.0f, 1.0f }, tint);
+
 			rd = 1.0f / rd;
 			float rn = ((pos[3].x - pos[1].x) * (pos[0].y - pos[1].y) - (pos[3].y - pos[1].y) * (pos[0].x - pos[1].x)) * rd;
 			float sn = ((pos[2].x - pos[0].x) * (pos[0].y - pos[1].y) - (pos[2].y - pos[0].y) * (pos[0].x - pos[1].x)) * rd;
@@ -2663,8 +3943,6 @@ namespace olc
 				di.uv[i] *= q; di.w[i] *= q;
 				di.pos[i] = { (pos[i].x * vInvScreenSize.x) * 2.0f - 1.0f, ((pos[i].y * vInvScreenSize.y) * 2.0f - 1.0f) * -1.0f };
 			}
-			di.mode = nDecalMode;
-			vLayers[nTargetLayer].vecDecalInstance.push_back(di);
 		}
 	}
 
@@ -3033,7 +4311,7 @@ namespace olc
 		m_tp1 = m_tp2;
 
 		// Our time per frame coefficient
-		float fElapsedTime = elapsedTime.count();
+		float fElapsedTime = fFixedTimeStep > 0.0f ? fFixedTimeStep : elapsedTime.count();
 		fLastElapsed = fElapsedTime;
 
 		// Some platforms will need to check for events
@@ -3073,17 +4351,29 @@ namespace olc
 
 		//	renderer->ClearBuffer(olc::BLACK, true);
 
+		// Stage timings for profiling
+		using stageclock = std::chrono::steady_clock;
+		auto Seconds = [](stageclock::time_point a, stageclock::time_point b) { return std::chrono::duration<float>(b - a).count(); };
+		FrameTimings timings;
+		RenderStats stats;
+		stageclock::time_point tpStage = stageclock::now();
+
 		// Handle Frame Update
 		for (auto& ext : vExtensions) ext->OnBeforeUserUpdate(fElapsedTime);
 		if (!OnUserUpdate(fElapsedTime)) bAtomActive = false;
 		for (auto& ext : vExtensions) ext->OnAfterUserUpdate(fElapsedTime);
+		timings.fUserUpdate = Seconds(tpStage, stageclock::now());
 
 		// Display Frame
 		renderer->UpdateViewport(vViewPos, vViewSize);
 		renderer->ClearBuffer(olc::BLACK, true);
 
+		// Deferred CPU drawing lands before anything is uploaded
+		tpStage = stageclock::now();
+		for (auto& layer : vLayers) olc_FlushLayer(layer);
+		timings.fRasterize = Seconds(tpStage, stageclock::now());
+
 		// Layer 0 must always exist
-		vLayers[0].bUpdate = true;
 		vLayers[0].bShow = true;
 		SetDecalMode(DecalMode::NORMAL);
 		renderer->PrepareDrawing();
@@ -3095,18 +4385,23 @@ namespace olc
 				if (layer->funcHook == nullptr)
 				{
 					renderer->ApplyTexture(layer->nResID);
-					if (layer->bUpdate)
+					if (layer->bUpdate || !layer->vDirty.empty())
 					{
-						renderer->UpdateTexture(layer->nResID, layer->pDrawTarget);
-						layer->bUpdate = false;
+						tpStage = stageclock::now();
+						olc_UploadLayer(*layer, stats);
+						timings.fTextureUpload += Seconds(tpStage, stageclock::now());
 					}
 
 					renderer->DrawLayerQuad(layer->vOffset, layer->vScale, layer->tint);
+					stats.nDrawCalls++;
 
 					// Display Decals in order for this layer
-					for (auto& decal : layer->vecDecalInstance)
-						renderer->DrawDecal(decal);
+					tpStage = stageclock::now();
+					olc_DrawLayerDecals(*layer, stats);
+					stats.nAllocations += layer->decalArena.Allocations();
 					layer->vecDecalInstance.clear();
+					layer->decalArena.Reset();
+					timings.fDecalSubmit += Seconds(tpStage, stageclock::now());
 				}
 				else
 				{
@@ -3117,7 +4412,13 @@ namespace olc
 		}
 
 		// Present Graphics to screen
+		tpStage = stageclock::now();
 		renderer->DisplayFrame();
+		timings.fDisplayFrame = Seconds(tpStage, stageclock::now());
+		sFrameTimings = timings;
+		stats.nAllocations += nDecalAllocations;
+		nDecalAllocations = 0;
+		sRenderStats = stats;
 
 		// Update Title Bar
 		fFrameTimer += fElapsedTime;
@@ -3130,6 +4431,65 @@ namespace olc
 			platform->SetWindowTitle(sTitle);
 			nFrameCount = 0;
 		}
+
+		// Fixed length runs (benchmarks and soak tests)
+		nTotalFrames++;
+		if (nFrameLimit > 0 && nTotalFrames >= nFrameLimit)
+			bAtomActive = false;
+	}
+
+	void PixelGameEngine::olc_DrawLayerDecals(LayerDesc& layer, RenderStats& stats)
+	{
+		stats.nDecals += uint32_t(layer.vecDecalInstance.size());
+
+		// Group by mode then texture, keeping the submission order within each group
+		if (layer.bSortDecals)
+		{
+			auto Key = [](const DecalInstance& d) { return std::make_pair(int(d.mode), d.decal ? int64_t(d.decal->id) : int64_t(-1)); };
+			std::stable_sort(layer.vecDecalInstance.begin(), layer.vecDecalInstance.end(),
+				[&](const DecalInstance& a, const DecalInstance& b) { return Key(a) < Key(b); });
+		}
+
+		// Consecutive decals with the same texture and mode become one triangle list
+		DecalBatch batch;
+		auto Flush = [&]()
+		{
+			if (vBatchVertices.empty()) return;
+			batch.vertices = vBatchVertices.data();
+			batch.count = uint32_t(vBatchVertices.size());
+			renderer->DrawDecalBatch(batch);
+			stats.nBatches++;
+			stats.nDrawCalls++;
+			stats.nVertices += batch.count;
+			vBatchVertices.clear();
+		};
+
+		for (auto& decal : layer.vecDecalInstance)
+		{
+			// Outlines can't be joined up, they go through one at a time
+			if (decal.mode == DecalMode::WIREFRAME)
+			{
+				Flush();
+				renderer->DrawDecal(decal);
+				stats.nDrawCalls++;
+				continue;
+			}
+
+			if (decal.decal != batch.decal || decal.mode != batch.mode) Flush();
+			batch.decal = decal.decal;
+			batch.mode = decal.mode;
+
+			// Triangle fan to triangle list
+			for (uint32_t n = 1; n + 1 < decal.points; n++)
+			{
+				for (uint32_t i : { 0u, n, n + 1 })
+				{
+					if (vBatchVertices.size() == vBatchVertices.capacity()) nDecalAllocations++;
+					vBatchVertices.push_back({ { decal.pos[i].x, decal.pos[i].y, decal.w[i] }, decal.uv[i], decal.tint[i] });
+				}
+			}
+		}
+		Flush();
 	}
 
 	void PixelGameEngine::olc_ConstructFontSheet()
@@ -3475,6 +4835,26 @@ namespace olc
 			glEnd();
 		}
 
+		void DrawDecalBatch(const olc::DecalBatch& batch) override
+		{
+			SetDecalMode(batch.mode);
+
+			if (batch.decal == nullptr)
+				glBindTexture(GL_TEXTURE_2D, 0);
+			else
+				glBindTexture(GL_TEXTURE_2D, batch.decal->id);
+
+			glBegin(GL_TRIANGLES);
+			for (uint32_t n = 0; n < batch.count; n++)
+			{
+				const olc::DecalVertex& v = batch.vertices[n];
+				glColor4ub(v.tint.r, v.tint.g, v.tint.b, v.tint.a);
+				glTexCoord4f(v.uv.x, v.uv.y, 0.0f, v.pos[2]);
+				glVertex2f(v.pos[0], v.pos[1]);
+			}
+			glEnd();
+		}
+
 		uint32_t CreateTexture(const uint32_t width, const uint32_t height, const bool filtered) override
 		{
 			UNUSED(width);
@@ -3511,6 +4891,14 @@ namespace olc
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->width, spr->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
 		}
 
+		void UpdateTextureRegion(uint32_t id, olc::Sprite* spr, const olc::vi2d& pos, const olc::vi2d& size) override
+		{
+			UNUSED(id);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, spr->width);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData() + pos.y * spr->width + pos.x);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		}
+
 		void ReadTexture(uint32_t id, olc::Sprite* spr) override
 		{
 			glReadPixels(0, 0, spr->width, spr->height, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
@@ -3927,6 +5315,22 @@ namespace olc
 				glDrawArrays(GL_TRIANGLE_FAN, 0, decal.points);
 		}
 
+		void DrawDecalBatch(const olc::DecalBatch& batch) override
+		{
+			// The batch is already laid out the way the shader wants it, so it goes up as is
+			static_assert(sizeof(olc::DecalVertex) == sizeof(locVertex), "DecalVertex must match locVertex");
+
+			SetDecalMode(batch.mode);
+			if (batch.decal == nullptr)
+				glBindTexture(GL_TEXTURE_2D, rendBlankQuad.Decal()->id);
+			else
+				glBindTexture(GL_TEXTURE_2D, batch.decal->id);
+
+			locBindBuffer(0x8892, m_vbQuad);
+			locBufferData(0x8892, sizeof(olc::DecalVertex) * batch.count, batch.vertices, 0x88E0);
+			glDrawArrays(GL_TRIANGLES, 0, batch.count);
+		}
+
 		uint32_t CreateTexture(const uint32_t width, const uint32_t height, const bool filtered) override
 		{
 			UNUSED(width);
@@ -3964,6 +5368,14 @@ namespace olc
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->width, spr->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
 		}
 
+		void UpdateTextureRegion(uint32_t id, olc::Sprite* spr, const olc::vi2d& pos, const olc::vi2d& size) override
+		{
+			UNUSED(id);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, spr->width);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData() + pos.y * spr->width + pos.x);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		}
+
 		void ReadTexture(uint32_t id, olc::Sprite* spr) override
 		{
 			glReadPixels(0, 0, spr->width, spr->height, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
@@ -4076,7 +5488,7 @@ namespace olc
 			{
 				// Load sprite from input stream
 				ResourceBuffer rb = pack->GetFileBuffer(sImageFile);
-				bmp = Gdiplus::Bitmap::FromStream(SHCreateMemStream((BYTE*)rb.vMemory.data(), UINT(rb.vMemory.size())));
+				bmp = Gdiplus::Bitmap::FromStream(SHCreateMemStream((BYTE*)rb.Data(), UINT(rb.Size())));
 			}
 			else
 			{
@@ -4275,7 +5687,7 @@ namespace olc
 			if (pack != nullptr)
 			{
 				ResourceBuffer rb = pack->GetFileBuffer(sImageFile);
-				bytes = stbi_load_from_memory((unsigned char*)rb.vMemory.data(), rb.vMemory.size(), &w, &h, &cmp, 4);
+				bytes = stbi_load_from_memory((unsigned char*)rb.Data(), int(rb.Size()), &w, &h, &cmp, 4);
 			}
 			else
 			{
@@ -5030,6 +6442,158 @@ namespace olc {
 
 
 
+// O------------------------------------------------------------------------------O
+// | START RENDERER: Headless (draws nothing, for simulation and benchmarks)      |
+// O------------------------------------------------------------------------------O
+#if defined(OLC_GFX_HEADLESS)
+namespace olc
+{
+	class Renderer_Headless : public olc::Renderer
+	{
+	private:
+		uint32_t nNextTexture = 0;
+
+	public:
+		void PrepareDevice() override
+		{}
+
+		olc::rcode CreateDevice(std::vector<void*> params, bool bFullScreen, bool bVSYNC) override
+		{
+			return olc::rcode::OK;
+		}
+
+		olc::rcode DestroyDevice() override
+		{
+			return olc::rcode::OK;
+		}
+
+		void DisplayFrame() override
+		{}
+
+		void PrepareDrawing() override
+		{}
+
+		void SetDecalMode(const olc::DecalMode& mode) override
+		{}
+
+		void DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint) override
+		{}
+
+		void DrawDecal(const olc::DecalInstance& decal) override
+		{}
+
+		void DrawDecalBatch(const olc::DecalBatch& batch) override
+		{}
+
+		uint32_t CreateTexture(const uint32_t width, const uint32_t height, const bool filtered) override
+		{
+			// Hand out unique ids so decals and layers can still tell each other apart
+			return nNextTexture++;
+		}
+
+		void UpdateTexture(uint32_t id, olc::Sprite* spr) override
+		{}
+
+		void UpdateTextureRegion(uint32_t id, olc::Sprite* spr, const olc::vi2d& pos, const olc::vi2d& size) override
+		{}
+
+		void ReadTexture(uint32_t id, olc::Sprite* spr) override
+		{}
+
+		uint32_t DeleteTexture(const uint32_t id) override
+		{
+			return id;
+		}
+
+		void ApplyTexture(uint32_t id) override
+		{}
+
+		void UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) override
+		{}
+
+		void ClearBuffer(olc::Pixel p, bool bDepth) override
+		{}
+	};
+}
+#endif
+// O------------------------------------------------------------------------------O
+// | END RENDERER: Headless                                                       |
+// O------------------------------------------------------------------------------O
+
+
+
+// O------------------------------------------------------------------------------O
+// | START PLATFORM: Headless (no window, no input, runs the engine loop only)    |
+// O------------------------------------------------------------------------------O
+#if defined(OLC_PLATFORM_HEADLESS)
+namespace olc
+{
+	class Platform_Headless : public olc::Platform
+	{
+	public:
+		virtual olc::rcode ApplicationStartUp() override
+		{
+			return olc::rcode::OK;
+		}
+
+		virtual olc::rcode ApplicationCleanUp() override
+		{
+			return olc::rcode::OK;
+		}
+
+		virtual olc::rcode ThreadStartUp() override
+		{
+			return olc::rcode::OK;
+		}
+
+		virtual olc::rcode ThreadCleanUp() override
+		{
+			renderer->DestroyDevice();
+			return olc::OK;
+		}
+
+		virtual olc::rcode CreateGraphics(bool bFullScreen, bool bEnableVSYNC, const olc::vi2d& vViewPos, const olc::vi2d& vViewSize) override
+		{
+			if (renderer->CreateDevice({}, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
+			{
+				renderer->UpdateViewport(vViewPos, vViewSize);
+				return olc::rcode::OK;
+			}
+			else
+				return olc::rcode::FAIL;
+		}
+
+		virtual olc::rcode CreateWindowPane(const olc::vi2d& vWindowPos, olc::vi2d& vWindowSize, bool bFullScreen) override
+		{
+			// Nothing to create, pretend the window is exactly the requested size
+			ptrPGE->olc_UpdateMouseFocus(true);
+			ptrPGE->olc_UpdateKeyFocus(true);
+			return olc::OK;
+		}
+
+		virtual olc::rcode SetWindowTitle(const std::string& s) override
+		{
+			return olc::OK;
+		}
+
+		virtual olc::rcode StartSystemEventLoop() override
+		{
+			return olc::OK;
+		}
+
+		virtual olc::rcode HandleSystemEvent() override
+		{
+			return olc::OK;
+		}
+	};
+}
+#endif
+// O------------------------------------------------------------------------------O
+// | END PLATFORM: Headless                                                       |
+// O------------------------------------------------------------------------------O
+
+
+
 namespace olc
 {
 	void PixelGameEngine::olc_ConfigureSystem()
@@ -5062,6 +6626,10 @@ namespace olc
 		platform = std::make_unique<olc::Platform_GLUT>();
 #endif
 
+#if defined(OLC_PLATFORM_HEADLESS)
+		platform = std::make_unique<olc::Platform_Headless>();
+#endif
+
 
 
 #if defined(OLC_GFX_OPENGL10)
@@ -5072,6 +6640,10 @@ namespace olc
 		renderer = std::make_unique<olc::Renderer_OGL33>();
 #endif
 
+#if defined(OLC_GFX_HEADLESS)
+		renderer = std::make_unique<olc::Renderer_Headless>();
+#endif
+
 #if defined(OLC_GFX_OPENGLES2)
 		renderer = std::make_unique<olc::Renderer_OGLES2>();
 #endif